@@ -0,0 +1,307 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Utility/TimerScheduler.h"
+
+namespace MidiAsync {
+    // The library's one timer thread, for await timeouts and the managers' timers
+    TimerScheduler& timers();
+
+    // A detached task has nobody to rethrow to, its exception is logged here
+    void reportUnhandled(std::exception_ptr exception) noexcept;
+}
+
+
+// Coroutines suspended on an event. Waiters are resumed on the thread that
+// calls notify(), usually the MIDI input thread, so there is no thread per
+// waiter. Each waiter is resumed exactly once: by a matching value, by its
+// timeout or by cancelAll() with an empty result.
+template<typename T>
+class MidiWaitList {
+public:
+    using Filter = std::function<bool(const T&)>;
+
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        Filter filter;
+        std::atomic<bool> done{false};
+        std::optional<T> value;
+        std::atomic<TimerScheduler::TimerId> timer{0};
+    };
+
+private:
+    struct Shared {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Waiter>> waiters;
+        std::atomic<size_t> count{0};
+    };
+
+public:
+
+    MidiWaitList()
+        : m_shared(std::make_shared<Shared>())
+    {
+    }
+
+    ~MidiWaitList() {
+        cancelAll();
+    }
+
+    MidiWaitList(const MidiWaitList&) = delete;
+    MidiWaitList& operator=(const MidiWaitList&) = delete;
+
+    bool empty() const noexcept { return m_shared->count.load(std::memory_order_relaxed) == 0; }
+
+    void notify(const T& value) {
+        if (empty()) {
+            return;
+        }
+
+        std::vector<std::shared_ptr<Waiter>> matched;
+        {
+            std::lock_guard lk(m_shared->mutex);
+            auto& waiters = m_shared->waiters;
+            for (auto it = waiters.begin(); it != waiters.end();) {
+                if (!(*it)->filter || (*it)->filter(value)) {
+                    matched.push_back(std::move(*it));
+                    it = waiters.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            m_shared->count = waiters.size();
+        }
+
+        for (auto& w : matched) {
+            complete(w, value);
+        }
+    }
+
+    void cancelAll() {
+        std::vector<std::shared_ptr<Waiter>> waiters;
+        {
+            std::lock_guard lk(m_shared->mutex);
+            waiters.swap(m_shared->waiters);
+            m_shared->count = 0;
+        }
+
+        for (auto& w : waiters) {
+            complete(w, std::nullopt);
+        }
+    }
+
+    class Awaiter {
+    public:
+        using Poll = std::function<std::optional<T>()>;
+
+        Awaiter(MidiWaitList& list, Filter filter, std::optional<std::chrono::milliseconds> timeout, Poll poll = nullptr)
+            : m_shared(list.m_shared)
+            , m_waiter(std::make_shared<Waiter>())
+            , m_timeout(timeout)
+            , m_poll(std::move(poll))
+        {
+            m_waiter->filter = std::move(filter);
+        }
+
+        bool await_ready() {
+            if (m_poll) {
+                m_waiter->value = m_poll();
+            }
+            return m_waiter->value.has_value();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            // Once the waiter is registered another thread may resume the
+            // coroutine and destroy this awaiter, only use locals from here on.
+            auto shared = m_shared;
+            auto waiter = m_waiter;
+            auto poll = m_poll;
+            const auto timeout = m_timeout;
+
+            waiter->handle = handle;
+
+            {
+                std::lock_guard lk(shared->mutex);
+                shared->waiters.push_back(waiter);
+                shared->count = shared->waiters.size();
+            }
+
+            // The event may have happened between await_ready and registering
+            if (poll) {
+                if (auto value = poll()) {
+                    if (!waiter->done.exchange(true)) {
+                        remove(*shared, waiter.get());
+                        waiter->value = std::move(value);
+                        return false;
+                    }
+                }
+            }
+
+            // Armed only once registered, so a timeout always finds the waiter
+            // to remove. If it completes first the timer finds it done and
+            // does nothing.
+            if (timeout) {
+                waiter->timer = MidiAsync::timers().after(*timeout, [shared, waiter]() {
+                    if (waiter->done.exchange(true)) {
+                        return;
+                    }
+                    remove(*shared, waiter.get());
+                    waiter->handle.resume();
+                });
+            }
+
+            return true;
+        }
+
+        std::optional<T> await_resume() {
+            return std::move(m_waiter->value);
+        }
+
+    private:
+        std::shared_ptr<Shared> m_shared;
+        std::shared_ptr<Waiter> m_waiter;
+        std::optional<std::chrono::milliseconds> m_timeout;
+        Poll m_poll;
+    };
+
+    Awaiter wait(Filter filter = nullptr, std::optional<std::chrono::milliseconds> timeout = std::nullopt,
+                 typename Awaiter::Poll poll = nullptr) {
+        return Awaiter(*this, std::move(filter), timeout, std::move(poll));
+    }
+
+private:
+    static void remove(Shared& shared, const Waiter* waiter) {
+        std::lock_guard lk(shared.mutex);
+        std::erase_if(shared.waiters, [waiter](const std::shared_ptr<Waiter>& w) { return w.get() == waiter; });
+        shared.count = shared.waiters.size();
+    }
+
+    static void complete(const std::shared_ptr<Waiter>& waiter, std::optional<T> value) {
+        if (waiter->done.exchange(true)) {
+            return;
+        }
+        if (const auto timer = waiter->timer.load()) {
+            MidiAsync::timers().cancel(timer);
+        }
+        waiter->value = std::move(value);
+        waiter->handle.resume();
+    }
+
+    std::shared_ptr<Shared> m_shared;
+};
+
+
+// Lazily started coroutine. Await it from another coroutine, or detach() it to
+// run on its own; a detached task frees itself when it finishes.
+template<typename T = void>
+class MidiTask {
+    struct PromiseBase {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+        bool detached{false};
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                auto& promise = handle.promise();
+                if (promise.continuation) {
+                    return promise.continuation;
+                }
+                if (promise.detached) {
+                    if (promise.exception) {
+                        MidiAsync::reportUnhandled(promise.exception);
+                    }
+                    handle.destroy();
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    struct ValuePromise : PromiseBase {
+        std::optional<T> value;
+
+        MidiTask get_return_object() { return MidiTask(std::coroutine_handle<ValuePromise>::from_promise(*this)); }
+        void return_value(T v) { value = std::move(v); }
+
+        T result() {
+            if (this->exception) {
+                std::rethrow_exception(this->exception);
+            }
+            return std::move(*value);
+        }
+    };
+
+    struct VoidPromise : PromiseBase {
+        MidiTask get_return_object() { return MidiTask(std::coroutine_handle<VoidPromise>::from_promise(*this)); }
+        void return_void() {}
+
+        void result() {
+            if (this->exception) {
+                std::rethrow_exception(this->exception);
+            }
+        }
+    };
+
+public:
+    using promise_type = std::conditional_t<std::is_void_v<T>, VoidPromise, ValuePromise>;
+
+    MidiTask(MidiTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    MidiTask& operator=(MidiTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    ~MidiTask() { reset(); }
+
+    // Does nothing on an empty or moved-from task
+    void detach() {
+        auto handle = std::exchange(m_handle, nullptr);
+        if (!handle) {
+            return;
+        }
+        handle.promise().detached = true;
+        handle.resume();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        m_handle.promise().continuation = continuation;
+        return m_handle;
+    }
+
+    decltype(auto) await_resume() { return m_handle.promise().result(); }
+
+private:
+    explicit MidiTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    void reset() {
+        if (m_handle) {
+            m_handle.destroy();
+            m_handle = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <libremidi/libremidi.hpp>
+#include <string_view>
+#include <vector>
+
+// The libremidi API a manager and all its devices use. Ports found with one
+// backend can only be opened with the same one.
+enum class MidiBackend {
+    Default,            // libremidi's platform default
+    AlsaSequencer,
+    AlsaRaw,
+    Jack,
+    Dummy
+};
+
+namespace MidiBackends {
+    libremidi::API api(MidiBackend backend) noexcept;
+    std::string_view name(MidiBackend backend) noexcept;
+
+    // Compiled into libremidi on this platform. Default always is.
+    bool isAvailable(MidiBackend backend);
+
+    // Whether libremidi runs the input callback on a thread of its own. JACK,
+    // CoreMIDI and WinMM call it from the server's or the system's thread,
+    // whose scheduling isn't ours to change.
+    bool ownsInputThread(MidiBackend backend) noexcept;
+    std::vector<MidiBackend> available();
+
+    libremidi::midi_in makeInput(const libremidi::input_configuration& config, MidiBackend backend);
+    libremidi::midi_out makeOutput(const libremidi::output_configuration& config, MidiBackend backend);
+    libremidi::observer makeObserver(const libremidi::observer_configuration& config, MidiBackend backend);
+}
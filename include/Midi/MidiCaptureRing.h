@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+
+// Fixed size retroactive capture buffer. The input thread is the only writer and
+// never blocks; once full, the oldest event is simply overwritten. Snapshots may
+// be taken from any thread and only return slots that were not overwritten while
+// they were being copied. Only messages of up to three bytes are captured.
+class MidiCaptureRing {
+public:
+    static constexpr size_t DefaultCapacity = 1 << 15;
+
+    explicit MidiCaptureRing(size_t capacity = DefaultCapacity);
+    ~MidiCaptureRing() = default;
+
+    MidiCaptureRing(const MidiCaptureRing&) = delete;
+    MidiCaptureRing& operator=(const MidiCaptureRing&) = delete;
+
+    void add(const MidiMessage& msg) noexcept;
+
+    // Events captured within the last `window` before now. Timestamps are in
+    // milliseconds relative to the first returned event.
+    std::vector<MidiMessageRecord> snapshot(std::chrono::milliseconds window) const;
+    std::vector<MidiMessageRecord> snapshot() const;
+
+    size_t capacity() const noexcept { return m_mask + 1; }
+    size_t memoryUsage() const noexcept { return capacity() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        std::atomic<int64_t> timestamp{0};
+        std::atomic<uint64_t> payload{0};
+    };
+
+    static constexpr uint64_t InvalidPayload = ~uint64_t{0};
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    std::atomic<uint64_t> m_head{0};
+};
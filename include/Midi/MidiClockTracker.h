@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "types.h"
+
+class MidiTransport;
+
+
+enum class MidiTransportState : uint8_t {
+    Stopped,
+    Playing
+};
+
+struct MidiClockState {
+    static constexpr int PPQN = 24;
+
+    MidiTransportState state{MidiTransportState::Stopped};
+    uint64_t ticks{0};              // since Start or the last song position
+    double bpm{0.0};                // 0 until enough ticks were seen
+    double tickPeriod{0.0};         // nanoseconds
+    double jitter{0.0};             // RMS deviation from the fitted grid, nanoseconds
+    int64_t lastTick{0};            // steady_clock nanoseconds of the last tick on the fitted grid,
+                                    // its arrival time until enough ticks were seen
+
+    // Beat position at a steady_clock time, extrapolated from the last tick
+    double beatAt(std::chrono::steady_clock::time_point time) const noexcept {
+        if (tickPeriod <= 0.0) {
+            return static_cast<double>(ticks) / PPQN;
+        }
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        const double phase = static_cast<double>(now - lastTick) / tickPeriod;
+        return (static_cast<double>(ticks) + (phase > 1.0 ? 1.0 : phase)) / PPQN;
+    }
+};
+
+
+// Follows MIDI clock (F8), start (FA), continue (FB), stop (FC) and song position
+// (F2) instead of handing every tick to user callbacks. The tick period is a
+// least squares fit over the last ticks' backend timestamps, which rejects
+// most of the delivery jitter. State is published under a sequence counter so
+// it can be polled from any thread without locking.
+class MidiClockTracker {
+public:
+    static constexpr size_t Window = 48;
+
+    MidiClockTracker(MidiTransport& transport);
+    ~MidiClockTracker() = default;
+
+    static bool isClockMessage(const MidiMessage& msg) noexcept;
+
+    void add(const MidiMessage& msg);
+    MidiClockState state() const;
+
+    void operator()(MidiMessage& msg);
+
+private:
+    void tick(int64_t backendTime, int64_t localTime);
+    void fit();
+    void publish();
+
+    MidiTransport& m_transport;
+
+    // Writer only
+    std::array<int64_t, Window> m_times{};
+    std::array<int64_t, Window> m_offsets{};    // arrival minus backend time
+    size_t m_head{0};
+    size_t m_count{0};
+    MidiClockState m_current;
+
+    std::atomic<uint64_t> m_sequence{0};
+    std::atomic<MidiTransportState> m_state{MidiTransportState::Stopped};
+    std::atomic<uint64_t> m_ticks{0};
+    std::atomic<double> m_bpm{0.0};
+    std::atomic<double> m_tickPeriod{0.0};
+    std::atomic<double> m_jitter{0.0};
+    std::atomic<int64_t> m_lastTick{0};
+};
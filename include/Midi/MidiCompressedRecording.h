@@ -0,0 +1,132 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory_resource>
+#include <vector>
+
+#include "types.h"
+
+// Packed recording format. Events are stored as a zigzag varint timestamp delta
+// followed by the status byte (elided when it matches the running status) and
+// the data bytes. Events are packed into fixed size blocks; every block resets
+// the running status and timestamp base so it can be decoded on its own.
+class MidiCompressedRecording {
+public:
+    static constexpr size_t BlockSize = 4096;
+
+    struct BlockHeader {
+        int64_t firstTimestamp;
+        int64_t lastTimestamp;
+        uint32_t count;
+        uint32_t used;
+    };
+
+    struct Block {
+        static constexpr size_t Capacity = BlockSize - sizeof(BlockHeader);
+
+        BlockHeader header;
+        std::array<uint8_t, Capacity> data;
+    };
+
+    // Blocks come from resource. A copy uses the default resource, like any
+    // pmr container.
+    explicit MidiCompressedRecording(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_blocks(resource)
+    {
+    }
+
+    void add(const MidiMessage& msg, int64_t timestamp);
+    void clear();
+
+    size_t size() const noexcept { return m_count; }
+    bool empty() const noexcept { return m_count == 0; }
+    size_t blockCount() const noexcept { return m_blocks.size(); }
+    size_t memoryUsage() const noexcept { return m_blocks.size() * sizeof(Block); }
+
+    const BlockHeader& header(size_t block) const { return m_blocks[block].header; }
+
+    // Index of the first block that can contain events at or after timestamp.
+    size_t findBlock(int64_t timestamp) const noexcept;
+
+    void decodeBlock(size_t block, std::vector<MidiMessageRecord>& out) const;
+    std::vector<MidiMessageRecord> decode() const;
+
+    // Calls fn(const uint8_t* bytes, size_t size, int64_t timestamp) for every event
+    // in the block. The bytes are only valid for the duration of the call.
+    template<typename Fn>
+    void forEachInBlock(size_t block, Fn&& fn) const;
+
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i < m_blocks.size(); i++) {
+            forEachInBlock(i, fn);
+        }
+    }
+
+private:
+    static constexpr uint8_t SystemMarker = 0xF0;
+
+    static size_t dataLength(uint8_t status) noexcept {
+        const uint8_t type = status & 0xF0;
+        return (type == 0xC0 || type == 0xD0) ? 1 : 2;
+    }
+
+    static uint64_t readVarint(const uint8_t*& p) noexcept {
+        uint64_t value = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            byte = *p++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    Block& blockFor(size_t bytesNeeded, int64_t timestamp);
+
+    std::pmr::deque<Block> m_blocks;
+    size_t m_count{0};
+    uint8_t m_runningStatus{0};
+};
+
+
+template<typename Fn>
+void MidiCompressedRecording::forEachInBlock(size_t block, Fn&& fn) const {
+    const Block& b = m_blocks[block];
+    const uint8_t* p = b.data.data();
+    const uint8_t* end = p + b.header.used;
+
+    int64_t timestamp = b.header.firstTimestamp;
+    uint8_t runningStatus = 0;
+    std::array<uint8_t, 3> buffer;
+
+    while (p < end) {
+        const uint64_t zigzag = readVarint(p);
+        timestamp += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+
+        if (*p == SystemMarker) {
+            p++;
+            const size_t length = static_cast<size_t>(readVarint(p));
+            fn(p, length, timestamp);
+            p += length;
+            runningStatus = 0;
+            continue;
+        }
+
+        if (*p & 0x80) {
+            runningStatus = *p++;
+        }
+
+        const size_t length = dataLength(runningStatus);
+        buffer[0] = runningStatus;
+        buffer[1] = p[0];
+        if (length == 2) {
+            buffer[2] = p[1];
+        }
+        p += length;
+
+        fn(buffer.data(), length + 1, timestamp);
+    }
+}
@@ -4,15 +4,57 @@
 #include <vector>
 #include <functional>
 #include <chrono>
+#include <memory_resource>
+#include <optional>
 #include <libremidi/libremidi.hpp>
 #include <source_location>
 
 #include "types.h"
+#include "MidiBackend.h"
+#include "MidiCompressedRecording.h"
+#include "MidiCaptureRing.h"
+#include "MidiRecordingIndex.h"
+#include "MidiStatistics.h"
+#include "MidiOutputScheduler.h"
+#include "MidiGridFramebuffer.h"
+#include "MidiOutputEncoder.h"
+#include "MidiClockTracker.h"
+#include "MidiNoteState.h"
+#include "MidiHighResDecoder.h"
+#include "MidiTransform.h"
+#include "MidiThru.h"
+#include "MidiRealtime.h"
+#include "MidiAsync.h"
+#include "Utility/AppendLog.h"
+#include "Utility/AllocationCounter.h"
+#include "Utility/SpanTracer.h"
+#include "Utility/RcuPointer.h"
 
 class MidiTransport {
 public:
-    MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort, MidiMessageCallback cb);
-    MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort);
+    MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort, MidiMessageCallback cb,
+                  MidiBackend backend = MidiBackend::Default);
+    MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort,
+                  MidiBackend backend = MidiBackend::Default);
+
+    // Input goes straight to handler without the type-erased user callback
+    template<typename Handler>
+    MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort, std::reference_wrapper<Handler> handler,
+                  MidiBackend backend = MidiBackend::Default)
+        : m_midiIn(MidiBackends::makeInput(inputConfiguration([this, handler](MidiMessage&& msg) {
+            AllocationScope scope;
+            TraceSpan span("transport.input");
+            checkRealtime();
+            handler.get()(msg);
+        }), backend))
+        , m_midiOut(MidiBackends::makeOutput(libremidi::output_configuration{}, backend))
+        , m_inPort(inPort)
+        , m_outPort(outPort)
+        , m_ownsInputThread(MidiBackends::ownsInputThread(backend))
+    {
+        m_encoder.setRunningStatus(false);
+    }
+
     ~MidiTransport();
 
     const libremidi::input_port& inPort() const noexcept;
@@ -22,20 +64,62 @@ public:
     void close();
 
     void send(const std::vector<unsigned char>& msg);
+    void send(const unsigned char* data, size_t size);
+    // Called by MidiThruTable, sends and records the notes for releaseForwardedNotes()
+    void forward(const unsigned char* data, size_t size);
+    void schedule(const std::vector<unsigned char>& msg, MidiOutputScheduler::Clock::time_point when);
+    void schedule(const std::vector<unsigned char>& msg, MidiOutputScheduler::Clock::time_point when, MidiOutputPriority priority);
+
+    void setOutputBandwidth(size_t bytesPerSecond);
+    MidiOutputStats outputStats() const;
+
+    // Batched output, coalesced and encoded on flush()
+    void queue(const std::vector<unsigned char>& msg);
+    void flush();
+    void setRunningStatus(bool enabled);
+    MidiEncoderStats encoderStats() const;
+
     void onMidiMessage(MidiMessageCallback cb);
     void onErrorMessage(ErrorCallback cb);
     void onWarningMessage(WarningCallback cb);
 
+    // Runs the input thread SCHED_FIFO at priority from its next message on,
+    // 0 restores the policy it had before. Backend errors and warnings then go
+    // to MidiDeferredLog instead of being logged on the input thread. Input
+    // threads the backend doesn't own keep their scheduling.
+    void setRealtime(int priority) noexcept;
+
     void operator()(MidiMessage& msg);
 private:
+    libremidi::input_configuration inputConfiguration(std::function<void(MidiMessage&&)> onMessage);
+
     void handleMidiMessage(MidiMessage& msg);
     void handleErrorMessage(std::string_view info, const std::source_location&);
     void handleWarningMessage(std::string_view info, const std::source_location&);
 
+    void sendNow(const unsigned char* data, size_t size);
+    MidiOutputScheduler& scheduler();
+
+    void checkRealtime() noexcept {
+        const int requested = m_realtimePriority.load(std::memory_order_relaxed);
+        if (requested != m_appliedPriority) {
+            applyRealtime(requested);
+        }
+    }
+    void applyRealtime(int priority) noexcept;
+
     std::mutex m_mutex;
     libremidi::midi_in m_midiIn;
     libremidi::midi_out m_midiOut;
 
+    // Created on first use, most devices never need one
+    mutable std::mutex m_schedulerMutex;
+    std::unique_ptr<MidiOutputScheduler> m_scheduler;
+    std::atomic<bool> m_shaping{false};
+
+    mutable std::mutex m_encoderMutex;
+    MidiOutputEncoder m_encoder;
+
     libremidi::input_port m_inPort;
     libremidi::output_port m_outPort;
 
@@ -43,13 +127,19 @@ private:
 
     ErrorCallback m_errorCb;
     WarningCallback m_warningCb;
+
+    std::atomic<int> m_realtimePriority{0};
+    int m_appliedPriority{0};           // input thread only
+    std::optional<MidiRealtime::Scheduling> m_savedScheduling;     // input thread only
+    const bool m_ownsInputThread;
 };
 
 
 class MidiIdentityVerifier {
 public:
-    MidiIdentityVerifier(MidiTransport& transport, double timeout = 2.0);
-    ~MidiIdentityVerifier();
+    MidiIdentityVerifier(MidiTransport& transport, double timeout = 2.0,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    ~MidiIdentityVerifier() = default;
 
     void verify();
     void onVerified(VerificationCallback cb);
@@ -66,7 +156,7 @@ private:
     VerificationCallback m_verifyCallback;
     
     std::mutex m_mutex;
-    std::vector<unsigned char> m_identity;
+    std::pmr::vector<unsigned char> m_identity;
     Availability m_status{Availability::NotChecked};
 
     std::string m_deviceName;
@@ -79,24 +169,44 @@ private:
 
 class MidiRecorder {
 public:
-    MidiRecorder(MidiTransport& transport);
+    MidiRecorder(MidiTransport& transport, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     ~MidiRecorder() = default;
 
     void start();
     void stop();
     void add(const libremidi::message& msg);
     void clear();
-    const std::vector<MidiMessageRecord>& recorded() const noexcept;
+    MidiRecordingSnapshot recorded() const;
+    // Copy of the packed blocks, taken under the writer's lock
+    MidiCompressedRecording compressed() const;
+
+    void setMode(RecordingMode mode);
+    RecordingMode mode() const noexcept { return m_mode; }
+
+    void enableIndex();
+    bool isIndexed() const noexcept { return m_index.load() != nullptr; }
+    MidiQueryResult query(const MidiQuery& query) const;
 
     bool isRecording() const noexcept { return m_recording; }
 
 private:
     MidiTransport& m_transport;
     std::atomic<bool> m_recording{false};
-    std::mutex m_mutex;
-    std::vector<MidiMessageRecord> m_recorded;
+    std::atomic<RecordingMode> m_mode{RecordingMode::Full};
+    mutable std::mutex m_mutex;
+    AppendLog<MidiMessageRecord> m_recorded;
+    MidiCompressedRecording m_compressed;
 
+    // Created once on demand and kept for the lifetime of the recorder
+    std::shared_ptr<MidiRecordingIndex> m_indexStorage;
+    std::atomic<MidiRecordingIndex*> m_index{nullptr};
+
+    // Odd while clear() runs, lets query() detect a clear between its snapshots
+    std::atomic<uint64_t> m_generation{0};
+
+    // One time base per log, so timestamps never go backwards across stop/start
     std::chrono::steady_clock::time_point m_start;
+    bool m_started{false};
 };
 
 
@@ -116,7 +226,10 @@ private:
 
 class MidiDevice {
 public:
-    MidiDevice(libremidi::input_port inPort, libremidi::output_port outPort);
+    MidiDevice(libremidi::input_port inPort, libremidi::output_port outPort, 
+               size_t captureCapacity = MidiCaptureRing::DefaultCapacity,
+               std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+               MidiBackend backend = MidiBackend::Default);
     ~MidiDevice();
 
     MidiDevice(const MidiDevice&) = delete;
@@ -126,16 +239,96 @@ public:
     
     void startRecording();
     void stopRecording();
-    const std::vector<MidiMessageRecord>& recorded() const noexcept;
+    MidiRecordingSnapshot recorded() const;
+    MidiCompressedRecording compressedRecorded() const;
+
+    void setRecordingMode(RecordingMode mode);
+    RecordingMode recordingMode() const noexcept;
+
+    void enableRecordingIndex();
+    MidiQueryResult query(const MidiQuery& query) const;
+
+    std::vector<MidiMessageRecord> captureLast(std::chrono::milliseconds window) const;
+    size_t captureCapacity() const noexcept;
+
+    void enableStatistics(bool enabled);
+    void resetStatistics();
+    MidiStatisticsSnapshot statistics() const;
+
+    MidiClockState clock() const;
+
+    // Held notes and controller values, off until enabled
+    void enableNoteState(bool enabled);
+    const MidiNoteState& noteState() const noexcept;
+    void releaseAllNotes();
+    // Notes that thru routes sent to this output, tracked as they were sent
+    // (transformed and channel-rewritten) while note state is enabled
+    const MidiNoteState& forwardedNoteState() const noexcept;
+    void releaseForwardedNotes();
+
+    // 14-bit controllers, NRPN/RPN and MPE expression as single events,
+    // decoding is off while no callback is set
+    void onHighResEvent(HighResEventCallback cb);
+
+    // Rewrites live channel messages before they are dispatched, recording
+    // and capture keep the input as played. nullptr removes it.
+    void setTransform(std::shared_ptr<const MidiTransform> transform);
+    std::shared_ptr<const MidiTransform> transform() const;
+
+    // Set by the manager from its routes, see MidiDeviceManager::addRoute()
+    void setThru(std::shared_ptr<const MidiThruTable> table);
+
+    // See MidiTransport::setRealtime()
+    void setRealtime(int priority) noexcept;
+    MidiThruStats thruStats() const noexcept;
+    void resetThruStats() noexcept;
+
+    // Liveness, all times are steady_clock
+    std::chrono::steady_clock::time_point lastActivity() const noexcept;
+    bool sendsActiveSensing() const noexcept;
+    bool isStalled() const noexcept;
+    void setStalled(bool stalled) noexcept;
+    void probe();
+
+    void send(const std::vector<unsigned char>& msg);
+    void send(const unsigned char* data, size_t size);
+    // Called by MidiThruTable, sends and records the notes for releaseForwardedNotes()
+    void forward(const unsigned char* data, size_t size);
+    void schedule(const std::vector<unsigned char>& msg, MidiOutputScheduler::Clock::time_point when);
+    void setOutputBandwidth(size_t bytesPerSecond);
+    MidiOutputStats outputStats() const;
+
+    void queue(const std::vector<unsigned char>& msg);
+    void flush();
+
+    // Only known grid controllers have one, nullptr otherwise
+    MidiGridFramebuffer* framebuffer();
 
     void onMessage(MidiMessageCallback cb);
+    // Every message of an available device as it arrived, before clock
+    // tracking, the transform or the channel message filter. Runs on the
+    // input thread, nullptr removes it.
+    void onRawMessage(MidiMessageCallback cb);
     void onVerified(VerificationCallback cb);
+
+    // Awaitables, resumed on the input thread. An empty result means the wait
+    // timed out or the device was destroyed.
+    MidiWaitList<Availability>::Awaiter verified(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+    MidiWaitList<MidiMessage>::Awaiter next(MidiMessageFilter filter = nullptr,
+                                            std::optional<std::chrono::milliseconds> timeout = std::nullopt);
     
     Availability status() const noexcept;
     std::vector<unsigned char> identity() const noexcept;
     std::string name() const noexcept;
     std::string displayName() const noexcept;
 
+    // Assigned by the manager, see MidiDeviceRegistry
+    static constexpr uint32_t NoOrdinal = UINT32_MAX;
+    MidiDeviceHandle handle() const noexcept;
+    void setHandle(MidiDeviceHandle handle) noexcept;
+    uint32_t nameOrdinal() const noexcept;
+    void setNameOrdinal(uint32_t ordinal) noexcept;
+
     void open(libremidi::input_port inPort, libremidi::output_port outPort);
     void close();
 
@@ -145,10 +338,33 @@ public:
 private:
     void onMidiMessage(MidiMessage& msg);
 
+    MidiDeviceHandle m_handle;
+    std::atomic<uint32_t> m_nameOrdinal{NoOrdinal};
+
     MidiTransport m_transport;
     MidiIdentityVerifier m_verifier;
     MidiRecorder m_recorder;
     MidiDispatcher m_dispatcher;
+    MidiStatistics m_statistics;
+    MidiClockTracker m_clock;
+    MidiNoteState m_noteState;
+    MidiNoteState m_forwardedNotes;
+    MidiHighResDecoder m_highRes;
+    RcuPointer<const MidiMessageCallback> m_rawCallback;
+    RcuPointer<const MidiTransform> m_transform;
+    RcuPointer<const MidiThruTable> m_thru;
+    MidiThruMeter m_thruMeter;
+    MidiCaptureRing m_captureRing;
+
+    std::atomic<int64_t> m_lastActivity{0};
+    std::atomic<bool> m_activeSensing{false};
+    std::atomic<bool> m_stalled{false};
+
+    std::mutex m_framebufferMutex;
+    std::unique_ptr<MidiGridFramebuffer> m_framebuffer;
+
+    MidiWaitList<Availability> m_verifiedWaiters;
+    MidiWaitList<MidiMessage> m_messageWaiters;
 };
 
 
@@ -245,4 +461,10 @@ namespace MidiDeviceDB {
     const std::unordered_map<std::string, DeviceIdentifier> KNOWN_DEVICES = {
         { "Novation Launchpad Pro", {{0x00, 0x20, 0x29}, { 0x51 }}}
     };
+
+    // Pads use programmer layout numbering (11 - 88), LEDs are set in bulk with
+    // F0 00 20 29 02 10 0A <pad> <colour> ... F7, up to 97 pads per message.
+    const std::unordered_map<std::string, GridLayout> KNOWN_GRIDS = {
+        { "Novation Launchpad Pro", { 8, 8, 11, 10, {0xF0, 0x00, 0x20, 0x29, 0x02, 0x10}, 0x0A, 97 }}
+    };
 }
\ No newline at end of file
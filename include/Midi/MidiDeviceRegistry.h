@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+class MidiDevice;
+
+
+// Hands out generation checked handles for devices. Lookup is an index into a
+// slot array, and since indices stay dense, per-device state can live in flat
+// arrays sized by slotCount() instead of maps keyed by name or pointer.
+//
+// Also numbers devices that share a display name, "Launchpad Pro",
+// "Launchpad Pro (1)", ..., always taking the lowest free number.
+class MidiDeviceRegistry {
+public:
+    MidiDeviceRegistry() = default;
+
+    MidiDeviceRegistry(const MidiDeviceRegistry&) = delete;
+    MidiDeviceRegistry& operator=(const MidiDeviceRegistry&) = delete;
+
+    MidiDeviceHandle add(std::shared_ptr<MidiDevice> device);
+    void remove(MidiDeviceHandle handle);
+
+    // nullptr if the handle is stale
+    std::shared_ptr<MidiDevice> get(MidiDeviceHandle handle) const;
+    bool contains(MidiDeviceHandle handle) const;
+
+    // Upper bound on handle indices handed out so far
+    size_t slotCount() const;
+
+    uint32_t acquireOrdinal(std::string_view displayName);
+    void releaseOrdinal(std::string_view displayName, uint32_t ordinal);
+
+private:
+    struct Slot {
+        std::shared_ptr<MidiDevice> device;
+        uint32_t generation{0};
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_free;
+
+    std::unordered_map<std::string, std::vector<bool>> m_ordinals;
+};
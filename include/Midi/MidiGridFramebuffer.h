@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MidiTransport;
+
+
+// How a grid controller addresses its pads and takes bulk LED updates
+struct GridLayout {
+    size_t rows;
+    size_t cols;
+    unsigned char firstPad;     // note of the bottom left pad
+    unsigned char rowStride;    // note distance between rows
+    std::vector<unsigned char> sysexHeader;
+    unsigned char ledCommand;   // followed by <pad> <colour> pairs
+    size_t maxLedsPerMessage;
+};
+
+
+// Frame based LED output for grid controllers. Frames are diffed against the
+// last frame sent and only the changed pads go out, packed into the device's
+// bulk LED SysEx messages.
+class MidiGridFramebuffer {
+public:
+    static constexpr size_t MaxCells = 128;
+
+    // Row major, row 0 is the top row. Values are palette colours (0 - 127).
+    using Frame = std::array<uint8_t, MaxCells>;
+
+    MidiGridFramebuffer(MidiTransport& transport, GridLayout layout);
+    ~MidiGridFramebuffer() = default;
+
+    const GridLayout& layout() const noexcept { return m_layout; }
+    size_t rows() const noexcept { return m_layout.rows; }
+    size_t cols() const noexcept { return m_layout.cols; }
+
+    Frame& frame() noexcept { return m_back; }
+    void set(size_t row, size_t col, uint8_t colour) noexcept;
+    void fill(uint8_t colour) noexcept;
+
+    // Sends the back buffer, or a frame supplied by the caller.
+    // Returns the number of pads that changed.
+    size_t present();
+    size_t present(const Frame& frame);
+
+    // Forces the next present to resend every pad
+    void invalidate() noexcept;
+
+private:
+    size_t diff(const Frame& frame, std::array<uint8_t, MaxCells>& changed) const noexcept;
+    unsigned char padFor(size_t cell) const noexcept;
+
+    MidiTransport& m_transport;
+    GridLayout m_layout;
+    size_t m_cells;
+
+    Frame m_back{};
+    Frame m_front{};
+    bool m_valid{false};
+};
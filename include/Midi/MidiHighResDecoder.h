@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "types.h"
+#include "Utility/RcuPointer.h"
+
+class MidiTransport;
+
+
+// Assembles MSB/LSB controller pairs, NRPN/RPN selection plus data entry and
+// MPE per-note expression into single MidiHighResEvents, with a few bytes of
+// state per channel. Runs on the input thread only, the callback can be
+// replaced from any thread.
+//
+// Nothing is held back: an MSB is emitted right away with a zero LSB and the
+// LSB, if the controller sends one, follows as a refinement. Waiting for an LSB
+// that may never come would delay the MSB until the next message.
+class MidiHighResDecoder {
+public:
+    MidiHighResDecoder(MidiTransport& transport);
+    ~MidiHighResDecoder() = default;
+
+    // Decoding is off while no callback is set
+    void onEvent(HighResEventCallback cb);
+    bool isEnabled() const noexcept { return static_cast<bool>(m_callback.read()); }
+
+    void add(const MidiMessage& msg);
+    void reset() noexcept;
+
+    // Member channel count of the lower (manager channel 0) and upper
+    // (manager channel 15) MPE zones, 0 when the zone is off
+    uint8_t lowerZone() const noexcept { return m_lowerZone; }
+    uint8_t upperZone() const noexcept { return m_upperZone; }
+
+    void operator()(MidiMessage& msg);
+
+private:
+    static constexpr uint8_t NullParameter = 0x7F;
+
+    struct ChannelState {
+        std::array<uint8_t, 32> msb{};
+
+        uint8_t parameterMsb{NullParameter};
+        uint8_t parameterLsb{NullParameter};
+        bool registered{false};
+        uint16_t data{0};
+
+        int8_t note{MidiHighResEvent::NoNote};
+    };
+
+    void controlChange(uint8_t channel, uint8_t number, uint8_t value);
+    void dataEntry(uint8_t channel, bool refinement = false);
+    void configureZone(uint8_t channel, uint8_t members);
+
+    bool isMemberChannel(uint8_t channel) const noexcept;
+    void emit(MidiHighResType type, uint8_t channel, uint16_t number, uint16_t value, bool refinement = false);
+
+    MidiTransport& m_transport;
+    RcuPointer<const HighResEventCallback> m_callback;
+
+    std::array<ChannelState, 16> m_channels{};
+    uint8_t m_lowerZone{0};
+    uint8_t m_upperZone{0};
+};
@@ -1,19 +1,29 @@
 #pragma once
 #include <libremidi/libremidi.hpp>
+#include <atomic>
 #include <vector>
 #include <functional>
 #include <mutex>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <source_location>
 
 #include "MidiDevice.h"
+#include "MidiDeviceRegistry.h"
 #include "types.h"
 #include "Utility/Debouncer.h"
+#include "Utility/TimerScheduler.h"
+#include "MidiTraceSink.h"
+
+#ifdef MIDIREWORK_SHARED_BUS
+#include "MidiSharedBus.h"
+#endif
 
 class MidiPortManager {
 public:
-    MidiPortManager();
+    MidiPortManager(MidiBackend backend = MidiBackend::Default,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     void scan();
 
@@ -38,8 +48,8 @@ private:
     void WarningMessage(std::string_view info, const std::source_location&);
 
     std::mutex m_mutex;
-    std::vector<libremidi::input_port> m_inPorts;
-    std::vector<libremidi::output_port> m_outPorts;
+    std::pmr::vector<libremidi::input_port> m_inPorts;
+    std::pmr::vector<libremidi::output_port> m_outPorts;
 
     std::function<void()> m_portsChanged;
     std::function<void(const libremidi::input_port &)> m_inputAdded;
@@ -55,11 +65,41 @@ private:
 
 class MidiDeviceManager {
 public:
-    MidiDeviceManager();
+    // Port lists, devices and their identity and recording storage are
+    // allocated from resource. It is used from the MIDI input and hot-plug
+    // threads, so it has to be thread safe, e.g. synchronized_pool_resource.
+    MidiDeviceManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // Ports are found and devices opened with backend. One that isn't built
+    // into libremidi falls back to the default with a warning.
+    MidiDeviceManager(MidiBackend backend, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    ~MidiDeviceManager();
+
+    std::pmr::memory_resource* resource() const noexcept;
+    MidiBackend backend() const noexcept;
 
     void startRecording();
     void stopRecording();
-    std::vector<std::pair<std::string, std::vector<MidiMessageRecord>>> recorded();
+    std::vector<std::pair<std::string, MidiRecordingSnapshot>> recorded();
+
+    void setRecordingMode(RecordingMode mode);
+    void enableRecordingIndex();
+
+    std::vector<std::pair<std::string, std::vector<MidiMessageRecord>>> captureLast(std::chrono::milliseconds window);
+
+    void enableStatistics(bool enabled);
+    std::vector<std::pair<std::string, MidiStatisticsSnapshot>> statistics();
+    void setCaptureCapacity(size_t capacity);
+
+    void enableNoteState(bool enabled);
+    void setTransform(std::shared_ptr<const MidiTransform> transform);
+
+    // Thru routes run on the source's input thread, before onMidiMessage.
+    // A route is dropped once either device is gone.
+    uint32_t addRoute(const MidiRoute& route);
+    void removeRoute(uint32_t id);
+    void clearRoutes();
+    std::vector<MidiRoute> routes();
+    std::vector<std::pair<std::string, MidiThruStats>> thruStats();
 
     void onError(ErrorCallback cb);
     void onWarning(WarningCallback cb);
@@ -68,20 +108,81 @@ public:
     void onDevicesRefresh(DeviceRefreshCallback cb);
     void onDeviceAdded(DeviceAddedCallback cb);
     void onDeviceRemoved(DeviceRemovedCallback cb);
+    void onDeviceStalled(DeviceStalledCallback cb);
+    void onHighResEvent(DeviceHighResEventCallback cb);
+
+    // Resumes with the next device that verifies as available
+    MidiWaitList<MidiDevice*>::Awaiter deviceAdded(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+    // Flags devices that stay silent for longer than timeout. Devices that don't
+    // send active sensing are probed after probeInterval of silence.
+    void enableLiveness(std::chrono::milliseconds probeInterval, std::chrono::milliseconds timeout);
+    void disableLiveness();
+
+#ifdef MIDIREWORK_SHARED_BUS
+    // Publishes every available device's input to a shared memory segment
+    // other processes can open with MidiSharedBusReader
+    bool enableSharedBus(const std::string& name, size_t capacity = MidiSharedBusPublisher::DefaultCapacity);
+    void disableSharedBus();
+#endif
+
+    // Locks memory and runs every input thread SCHED_FIFO at priority where
+    // permitted. Input path warnings are deferred and reported from a timer.
+    // Thru, recording and user callbacks are outside the real-time guarantee
+    // and not counted by RealtimeChecker.
+    bool enableRealtime(int priority = MidiRealtime::DefaultPriority);
+    void disableRealtime();
+
+    // Binary log of every available device's input as it arrived, before
+    // transforms, see MidiTraceReader
+    bool enableTrace(const std::string& path);
+    void disableTrace();
 
     std::vector<MidiDevice*> getDevices();
     std::vector<MidiDevice*> getAvailableDevices();
 
+    // O(1), nullptr once the device is gone. Handle indices stay below
+    // deviceSlotCount(), so per-device state can be kept in flat arrays.
+    std::shared_ptr<MidiDevice> getDevice(MidiDeviceHandle handle) const;
+    size_t deviceSlotCount() const;
+
     void refresh();
 
 private:
     bool portsMatch(const libremidi::input_port &in, const libremidi::output_port &out);
     void scanPorts();
 
+    // What a new device is set up with. Devices are created on the refresh
+    // workers and verified on their own input threads, so they read a copy
+    // taken under m_mutex rather than the members.
+    struct DeviceSettings {
+        bool recording;
+        RecordingMode recordingMode;
+        bool recordingIndexed;
+        bool statisticsEnabled;
+        bool noteStateEnabled;
+        std::shared_ptr<const MidiTransform> transform;
+        int realtimePriority;
+    };
+    DeviceSettings deviceSettings();
+
     void handlePortRefresh();
+    void openDevice(const libremidi::input_port &in, const libremidi::output_port &out);
+    void createDevice(const libremidi::input_port &in, const libremidi::output_port &out);
+    void resolveRoutes();
+    void reportDeferred();
+    void checkLiveness(std::chrono::milliseconds probeInterval, std::chrono::milliseconds timeout);
+
+    // Refresh opens new devices on up to this many threads
+    static constexpr size_t MaxOpeningThreads = 16;
 
+    std::pmr::memory_resource* m_resource;
+    MidiBackend m_backend;
+
+    // Guards m_devices only, never held while ports open or close
     std::mutex m_mutex;
-    std::vector<std::shared_ptr<MidiDevice>> m_devices;
+    std::pmr::vector<std::shared_ptr<MidiDevice>> m_devices;
+    MidiDeviceRegistry m_registry;
 
     ErrorCallback m_errorCallback;
     WarningCallback m_warningCallback;
@@ -90,21 +191,48 @@ private:
     DeviceRefreshCallback m_devicesRefreshCallback;
     DeviceAddedCallback m_deviceAddedCallback;
     DeviceRemovedCallback m_deviceRemovedCallback;
+    DeviceStalledCallback m_deviceStalledCallback;
+    DeviceHighResEventCallback m_highResCallback;
+    MidiWaitList<MidiDevice*> m_deviceAddedWaiters;
 
     Debouncer<std::vector<MidiDevice*>> m_deviceRefreshDebouncer;
-    Debouncer<MidiDevice*> m_deviceAddedDebouncer;
-    Debouncer<MidiDevice*> m_deviceRemovedDebouncer;
 
     Debouncer<> m_handlePortRefreshDebouncer;
 
     MidiPortManager m_portManager;
 
     bool m_recording;
+    RecordingMode m_recordingMode{RecordingMode::Full};
+    bool m_recordingIndexed{false};
+    bool m_statisticsEnabled{false};
+    bool m_noteStateEnabled{false};
+    std::shared_ptr<const MidiTransform> m_transform;
+
+    std::mutex m_routesMutex;
+    std::vector<std::pair<uint32_t, MidiRoute>> m_routes;
+    uint32_t m_nextRouteId{1};
+
+    TimerScheduler::TimerId m_livenessTimer{0};
+
+    int m_realtimePriority{0};
+    TimerScheduler::TimerId m_realtimeTimer{0};
+
+    RcuPointer<MidiTraceSink> m_trace;
+
+#ifdef MIDIREWORK_SHARED_BUS
+    RcuPointer<MidiSharedBusPublisher> m_sharedBus;
+#endif
+
+    std::atomic<size_t> m_captureCapacity{MidiCaptureRing::DefaultCapacity};
+
+    // Shared with the await timeouts, the destructor cancels this manager's timers
+    TimerScheduler& m_timers{MidiAsync::timers()};
 };
 
 class MidiManager : public MidiDeviceManager {
 public:
-    MidiManager();
+    MidiManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    MidiManager(MidiBackend backend, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 private:
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <optional>
+
+#include "types.h"
+
+class MidiTransport;
+
+
+// 128 note bits of one channel as two words, queries are popcount and bit scans
+struct MidiNoteSet {
+    std::array<uint64_t, 2> words{};
+
+    bool test(uint8_t note) const noexcept {
+        return note < 128 && (words[note >> 6] >> (note & 63)) & 1;
+    }
+
+    size_t count() const noexcept {
+        return static_cast<size_t>(std::popcount(words[0]) + std::popcount(words[1]));
+    }
+
+    bool empty() const noexcept {
+        return (words[0] | words[1]) == 0;
+    }
+
+    std::optional<uint8_t> lowest() const noexcept {
+        if (words[0]) return static_cast<uint8_t>(std::countr_zero(words[0]));
+        if (words[1]) return static_cast<uint8_t>(64 + std::countr_zero(words[1]));
+        return std::nullopt;
+    }
+
+    std::optional<uint8_t> highest() const noexcept {
+        if (words[1]) return static_cast<uint8_t>(127 - std::countl_zero(words[1]));
+        if (words[0]) return static_cast<uint8_t>(63 - std::countl_zero(words[0]));
+        return std::nullopt;
+    }
+
+    // Calls fn(note) for every held note, lowest first
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t w = 0; w < 2; w++) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                fn(static_cast<uint8_t>(w * 64 + std::countr_zero(bits)));
+            }
+        }
+    }
+};
+
+
+// Which notes are held and the last value of every controller, per channel
+// (0-15). Input threads set and clear bits with atomic RMWs, so queries
+// and releaseAll() can run on any thread without locking.
+class MidiNoteState {
+public:
+    MidiNoteState(MidiTransport& transport);
+    ~MidiNoteState() = default;
+
+    // Disabling forgets everything, the bits would go stale while nothing tracks them
+    void enable(bool enabled) {
+        m_enabled = enabled;
+        if (!enabled) {
+            clear();
+        }
+    }
+    bool isEnabled() const noexcept { return m_enabled; }
+
+    void add(const MidiMessage& msg);
+    void add(const unsigned char* data, size_t size);
+
+    bool isHeld(uint8_t channel, uint8_t note) const noexcept;
+    MidiNoteSet held(uint8_t channel) const noexcept;
+    size_t heldCount() const noexcept;
+    std::optional<uint8_t> controller(uint8_t channel, uint8_t number) const noexcept;
+
+    // Sends a note-off for each held note only, then forgets them
+    void releaseAll();
+    void clear() noexcept;
+
+    void operator()(MidiMessage& msg);
+
+private:
+    static constexpr uint8_t Unset = 0xFF;
+
+    void setNote(uint8_t channel, uint8_t note, bool on) noexcept;
+
+    MidiTransport& m_transport;
+    std::atomic<bool> m_enabled{false};
+
+    std::array<std::array<std::atomic<uint64_t>, 2>, 16> m_notes{};
+    std::array<std::array<std::atomic<uint8_t>, 128>, 16> m_controllers;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+struct MidiEncoderStats {
+    uint64_t messagesIn{0};
+    uint64_t messagesOut{0};
+    uint64_t bytesIn{0};
+    uint64_t bytesOut{0};
+};
+
+
+// Output stage that batches messages between flushes. On flush, CC and pitch
+// bend values replaced by a newer value for the same controller are dropped and
+// the rest is encoded in order, optionally using running status.
+class MidiOutputEncoder {
+public:
+    // Called once per encoded buffer. With running status every flush is one
+    // buffer, otherwise each remaining message is its own buffer.
+    using Sink = std::function<void(const unsigned char*, size_t)>;
+
+    MidiOutputEncoder();
+    ~MidiOutputEncoder() = default;
+
+    void push(const unsigned char* data, size_t size);
+    void push(const std::vector<unsigned char>& msg) { push(msg.data(), msg.size()); }
+
+    void flush(const Sink& sink);
+    void clear();
+
+    bool empty() const noexcept { return m_entries.empty(); }
+    size_t pending() const noexcept { return m_entries.size(); }
+
+    void setRunningStatus(bool enabled) noexcept { m_runningStatus = enabled; }
+    bool runningStatus() const noexcept { return m_runningStatus; }
+
+    const MidiEncoderStats& stats() const noexcept { return m_stats; }
+
+private:
+    struct Entry {
+        uint32_t offset;
+        uint32_t size;
+        bool dropped;
+    };
+
+    // Latest pending entry per key, valid while its generation matches the flush
+    struct Slot {
+        uint32_t generation;
+        uint32_t entry;
+    };
+
+    static bool coalescable(unsigned char controller) noexcept;
+    void supersede(Slot& slot, uint32_t entry) noexcept;
+
+    std::vector<unsigned char> m_bytes;
+    std::vector<Entry> m_entries;
+    std::vector<unsigned char> m_encoded;
+
+    std::array<Slot, 16 * 128> m_controllers{};
+    std::array<Slot, 16> m_pitchBend{};
+    uint32_t m_generation{1};
+
+    bool m_runningStatus{true};
+    MidiEncoderStats m_stats;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+enum class MidiOutputPriority {
+    Realtime,
+    Bulk
+};
+
+struct MidiOutputStats {
+    size_t queueDepth{0};
+    size_t peakQueueDepth{0};
+    uint64_t sent{0};
+    uint64_t bytesSent{0};
+    std::chrono::microseconds averageLag{0};
+    std::chrono::microseconds maxLag{0};
+};
+
+
+// Timestamped output queue with a token bucket per port. Realtime messages go
+// out as soon as they are due and may overdraw the budget; bulk messages wait
+// until the budget has recovered, so feedback traffic can never hold back notes.
+class MidiOutputScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Sink = std::function<void(const unsigned char*, size_t)>;
+
+    MidiOutputScheduler(Sink sink);
+    ~MidiOutputScheduler();
+
+    MidiOutputScheduler(const MidiOutputScheduler&) = delete;
+    MidiOutputScheduler& operator=(const MidiOutputScheduler&) = delete;
+
+    void schedule(std::vector<unsigned char> msg, Clock::time_point when, MidiOutputPriority priority);
+    void clear();
+
+    // Bytes per second, 0 disables shaping
+    void setBandwidth(size_t bytesPerSecond);
+    size_t bandwidth() const noexcept { return m_bandwidth; }
+
+    MidiOutputStats stats() const;
+
+    static MidiOutputPriority classify(const std::vector<unsigned char>& msg) noexcept;
+
+private:
+    struct Entry {
+        Clock::time_point due;
+        uint64_t order;
+        std::vector<unsigned char> bytes;
+    };
+
+    struct Later {
+        bool operator()(const Entry& a, const Entry& b) const noexcept {
+            return a.due != b.due ? a.due > b.due : a.order > b.order;
+        }
+    };
+
+    using Queue = std::priority_queue<Entry, std::vector<Entry>, Later>;
+
+    void run();
+    void refill(Clock::time_point now);
+    void emit(Entry& entry, Clock::time_point now, std::unique_lock<std::mutex>& lk);
+
+    Sink m_sink;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping{false};
+
+    Queue m_realtime;
+    Queue m_bulk;
+    uint64_t m_order{0};
+
+    std::atomic<size_t> m_bandwidth{0};
+    double m_tokens{0.0};
+    Clock::time_point m_lastRefill{Clock::now()};
+
+    size_t m_peakQueueDepth{0};
+    uint64_t m_sent{0};
+    uint64_t m_bytesSent{0};
+    std::chrono::microseconds m_totalLag{0};
+    std::chrono::microseconds m_maxLag{0};
+
+    std::jthread m_thread;
+};
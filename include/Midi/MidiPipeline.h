@@ -0,0 +1,193 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <utility>
+
+#include "MidiDevice.h"
+
+
+// A stage is anything callable with MidiMessage&. Stages returning bool stop
+// the pipeline by returning false, void stages always pass the message on.
+template<typename Stage>
+concept MidiStage = std::invocable<Stage&, MidiMessage&>;
+
+
+template<size_t Index, typename Stage>
+struct MidiStageSlot {
+    explicit MidiStageSlot(MidiTransport& transport) requires std::constructible_from<Stage, MidiTransport&>
+        : stage(transport) {}
+    explicit MidiStageSlot(MidiTransport&) requires (!std::constructible_from<Stage, MidiTransport&>)
+        : stage() {}
+    MidiStageSlot(MidiTransport&, Stage s)
+        : stage(std::move(s)) {}
+
+    Stage stage;
+};
+
+
+template<typename Indices, typename... Stages>
+class MidiPipelineImpl;
+
+template<size_t... Indices, typename... Stages>
+class MidiPipelineImpl<std::index_sequence<Indices...>, Stages...> : MidiStageSlot<Indices, Stages>... {
+public:
+    explicit MidiPipelineImpl(MidiTransport& transport)
+        : MidiStageSlot<Indices, Stages>(transport)... {}
+    MidiPipelineImpl(MidiTransport& transport, Stages... stages)
+        : MidiStageSlot<Indices, Stages>(transport, std::move(stages))... {}
+
+    // Expands to one inlined call per stage, && short circuits on a false stage
+    void operator()(MidiMessage& msg) {
+        (run(static_cast<MidiStageSlot<Indices, Stages>&>(*this).stage, msg) && ...);
+    }
+
+    template<size_t Index>
+    auto& get() noexcept {
+        return getSlot<Index>(*this).stage;
+    }
+
+    template<typename Stage>
+    Stage& get() noexcept {
+        return getStage<Stage>(*this).stage;
+    }
+
+    template<typename Fn>
+    void forEach(Fn&& fn) {
+        (fn(static_cast<MidiStageSlot<Indices, Stages>&>(*this).stage), ...);
+    }
+
+private:
+    template<typename Stage>
+    static bool run(Stage& stage, MidiMessage& msg) {
+        if constexpr (std::same_as<std::invoke_result_t<Stage&, MidiMessage&>, bool>) {
+            return stage(msg);
+        } else {
+            stage(msg);
+            return true;
+        }
+    }
+
+    template<size_t Index, typename Stage>
+    static MidiStageSlot<Index, Stage>& getSlot(MidiStageSlot<Index, Stage>& slot) noexcept { return slot; }
+
+    template<typename Stage, size_t Index>
+    static MidiStageSlot<Index, Stage>& getStage(MidiStageSlot<Index, Stage>& slot) noexcept { return slot; }
+};
+
+template<MidiStage... Stages>
+using MidiPipeline = MidiPipelineImpl<std::index_sequence_for<Stages...>, Stages...>;
+
+
+// Stops everything until the identity reply arrives, then only passes
+// messages on if the device turned out to be available.
+class MidiVerifyStage {
+public:
+    explicit MidiVerifyStage(MidiTransport& transport) : m_verifier(transport) {}
+
+    void onOpen() {
+        if (m_verifier.status() == Availability::NotChecked) {
+            m_verifier.verify();
+        }
+    }
+
+    bool operator()(MidiMessage& msg) {
+        if (m_verifier.status() == Availability::InProgress) {
+            m_verifier(msg);
+            return false;
+        }
+        return m_verifier.status() == Availability::Available;
+    }
+
+    MidiIdentityVerifier& verifier() noexcept { return m_verifier; }
+
+private:
+    MidiIdentityVerifier m_verifier;
+};
+
+// Only channel voice messages continue
+struct MidiChannelMessageStage {
+    bool operator()(const MidiMessage& msg) const noexcept {
+        return msg.size() == 3;
+    }
+};
+
+class MidiRecordStage {
+public:
+    explicit MidiRecordStage(MidiTransport& transport) : m_recorder(transport) {}
+
+    void operator()(const MidiMessage& msg) {
+        if (m_recorder.isRecording()) {
+            m_recorder.add(msg);
+        }
+    }
+
+    MidiRecorder& recorder() noexcept { return m_recorder; }
+
+private:
+    MidiRecorder m_recorder;
+};
+
+
+// Device with its per-event path fixed at compile time. The input callback goes
+// straight from the backend into the pipeline, every stage call is a direct
+// call the compiler can inline. Use MidiDevice when the stages aren't known
+// up front or the full feature set is wanted.
+//
+//   BasicMidiDevice<MidiVerifyStage, MidiChannelMessageStage, MidiStatistics, MidiDispatcher> device(in, out);
+template<MidiStage... Stages>
+class BasicMidiDevice {
+public:
+    using Pipeline = MidiPipeline<Stages...>;
+
+    BasicMidiDevice(libremidi::input_port inPort, libremidi::output_port outPort)
+        : m_transport(inPort, outPort, std::ref(m_pipeline))
+        , m_pipeline(m_transport)
+    {
+        open(inPort, outPort);
+    }
+
+    BasicMidiDevice(libremidi::input_port inPort, libremidi::output_port outPort, Stages... stages)
+        : m_transport(inPort, outPort, std::ref(m_pipeline))
+        , m_pipeline(m_transport, std::move(stages)...)
+    {
+        open(inPort, outPort);
+    }
+
+    ~BasicMidiDevice() {
+        close();
+    }
+
+    BasicMidiDevice(const BasicMidiDevice&) = delete;
+    BasicMidiDevice& operator=(const BasicMidiDevice&) = delete;
+
+    void open(libremidi::input_port inPort, libremidi::output_port outPort) {
+        m_transport.open(inPort, outPort);
+        m_pipeline.forEach([](auto& stage) {
+            if constexpr (requires { stage.onOpen(); }) {
+                stage.onOpen();
+            }
+        });
+    }
+
+    void close() {
+        m_transport.close();
+    }
+
+    void send(const std::vector<unsigned char>& msg) {
+        m_transport.send(msg);
+    }
+
+    template<size_t Index>
+    auto& stage() noexcept { return m_pipeline.template get<Index>(); }
+
+    template<typename Stage>
+    Stage& stage() noexcept { return m_pipeline.template get<Stage>(); }
+
+    MidiTransport& transport() noexcept { return m_transport; }
+
+private:
+    // The transport only keeps a reference to the pipeline, nothing is
+    // delivered until open() so the pipeline can be constructed second.
+    MidiTransport m_transport;
+    Pipeline m_pipeline;
+};
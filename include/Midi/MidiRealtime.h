@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <source_location>
+#include <string_view>
+
+
+namespace MidiRealtime {
+    // SCHED_FIFO priority used when none is given, below typical audio threads
+    constexpr int DefaultPriority = 70;
+
+    // mlockall on POSIX. Needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK,
+    // failures are logged and leave memory pageable.
+    bool lockMemory();
+    void unlockMemory();
+
+    // Policy and priority of a thread, saved before changing it so exactly
+    // that can be restored
+    struct Scheduling {
+        int policy{0};
+        int priority{0};
+    };
+
+    // None of these log, so they can run on the input thread
+    Scheduling currentThreadScheduling() noexcept;
+    bool setCurrentThreadScheduling(const Scheduling& scheduling) noexcept;
+
+    // SCHED_FIFO at priority, false if not permitted
+    bool setCurrentThreadPriority(int priority) noexcept;
+}
+
+
+// Bounded log for threads that must not format, allocate or block. Posting
+// copies a short text into a fixed slot of a lock-free multi-producer ring;
+// whoever owns the log drains it later and does the real logging.
+class MidiDeferredLog {
+public:
+    static constexpr size_t Capacity = 256;
+    static constexpr size_t TextSize = 120;
+
+    enum class Level : uint8_t {
+        Warning,
+        Error
+    };
+
+    struct Entry {
+        Level level;
+        uint8_t length;
+        char text[TextSize];
+        std::source_location location;
+
+        std::string_view message() const noexcept { return { text, length }; }
+    };
+
+    // The process wide log the MIDI input threads post to
+    static MidiDeferredLog& instance();
+
+    MidiDeferredLog();
+
+    // Truncates long text, false if the ring is full
+    bool post(Level level, std::string_view text,
+              const std::source_location& location = std::source_location::current()) noexcept;
+
+    // Returns how many entries were handed to fn
+    template<typename Fn>
+    size_t drain(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        size_t count = 0;
+        Entry entry;
+        while (pop(entry)) {
+            fn(entry);
+            count++;
+        }
+        return count;
+    }
+
+    uint64_t dropped() const noexcept;
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    bool pop(Entry& entry) noexcept;
+
+    std::array<Cell, Capacity> m_cells;
+    std::atomic<size_t> m_head{0};
+    std::mutex m_drainMutex;
+    size_t m_tail{0};
+    std::atomic<uint64_t> m_dropped{0};
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+#include "types.h"
+#include "Utility/AppendLog.h"
+
+using MidiRecordingSnapshot = AppendLog<MidiMessageRecord>::Snapshot;
+
+
+struct MidiQuery {
+    enum class Kind {
+        All,
+        Channel,
+        NoteOn,
+        NoteOff,
+        ControlChange
+    };
+
+    Kind kind{Kind::All};
+    int channel{1};         // 1 - 16, same as libremidi::message::get_channel()
+    int number{0};          // note or controller number
+    int64_t from{std::numeric_limits<int64_t>::min()};
+    int64_t to{std::numeric_limits<int64_t>::max()};   // exclusive
+};
+
+
+// View over the records matched by a query. Holds the snapshots it was built
+// from, so it stays valid while recording continues.
+class MidiQueryResult {
+public:
+    using PostingSnapshot = AppendLog<uint32_t, 256>::Snapshot;
+
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = MidiMessageRecord;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const MidiMessageRecord*;
+        using reference = const MidiMessageRecord&;
+
+        iterator() = default;
+        iterator(const MidiQueryResult* result, size_t pos) : m_result(result), m_pos(pos) {}
+
+        reference operator*() const { return m_result->at(m_pos); }
+        pointer operator->() const { return &m_result->at(m_pos); }
+
+        iterator& operator++() { ++m_pos; return *this; }
+        iterator operator++(int) { iterator tmp = *this; ++m_pos; return tmp; }
+
+        friend bool operator==(const iterator& a, const iterator& b) { return a.m_pos == b.m_pos; }
+
+    private:
+        const MidiQueryResult* m_result{nullptr};
+        size_t m_pos{0};
+    };
+
+    MidiQueryResult() = default;
+
+    // Matches every record in the time range, straight from the record log.
+    MidiQueryResult(MidiRecordingSnapshot records, size_t first, size_t last)
+        : m_records(std::move(records)), m_all(true), m_first(first), m_last(last) {}
+
+    MidiQueryResult(MidiRecordingSnapshot records, PostingSnapshot postings, size_t first, size_t last)
+        : m_records(std::move(records)), m_postings(std::move(postings)), m_all(false), m_first(first), m_last(last) {}
+
+    size_t size() const noexcept { return m_last - m_first; }
+    bool empty() const noexcept { return m_last == m_first; }
+
+    const MidiMessageRecord& operator[](size_t i) const { return at(m_first + i); }
+
+    iterator begin() const { return iterator(this, m_first); }
+    iterator end() const { return iterator(this, m_last); }
+
+private:
+    const MidiMessageRecord& at(size_t pos) const {
+        return m_all ? m_records[pos] : m_records[m_postings[pos]];
+    }
+
+    MidiRecordingSnapshot m_records;
+    PostingSnapshot m_postings;
+    bool m_all{true};
+    size_t m_first{0};
+    size_t m_last{0};
+};
+
+
+// Secondary indexes over a recorder's log. Posting lists hold record positions
+// in arrival order; since record timestamps never decrease, the record log
+// itself doubles as the time index and every lookup is a binary search.
+class MidiRecordingIndex {
+public:
+    // Posting list chunks come from resource, like the log they index
+    explicit MidiRecordingIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    MidiRecordingIndex(const MidiRecordingIndex&) = delete;
+    MidiRecordingIndex& operator=(const MidiRecordingIndex&) = delete;
+
+    // Writer side, records must be added in the same order as the log.
+    void add(const MidiMessageRecord& record);
+    void clear();
+
+    // Consistent only if the log isn't cleared while it runs, the owner has to
+    // check for that (see MidiRecorder::query())
+    MidiQueryResult query(const MidiQuery& query, const AppendLog<MidiMessageRecord>& records) const;
+
+private:
+    using PostingList = AppendLog<uint32_t, 256>;
+
+    const PostingList* postingsFor(const MidiQuery& query) const noexcept;
+
+    uint32_t m_next{0};
+
+    std::array<PostingList, 16> m_channel;
+    std::array<std::array<PostingList, 128>, 16> m_noteOn;
+    std::array<std::array<PostingList, 128>, 16> m_noteOff;
+    std::array<std::array<PostingList, 128>, 16> m_controlChange;
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+
+// Event bus in POSIX shared memory so other local processes can follow the
+// devices one manager has open. The segment holds a device table and a ring of
+// fixed size event slots. Every input thread publishes straight into the ring,
+// readers map the segment read-only and poll it; nothing goes through the
+// kernel per event.
+//
+// Each slot carries its sequence number. A writer marks the slot busy, fills
+// it and then publishes the sequence; a reader copies the slot and accepts it
+// only if the sequence is unchanged. A reader that falls more than a ring
+// behind skips ahead and counts the lost events as dropped.
+
+struct MidiSharedEvent {
+    static constexpr size_t MaxBytes = 13;
+
+    uint64_t sequence{0};
+    int64_t timestamp{0};       // steady_clock nanoseconds
+    uint16_t device{0};         // index into the device table
+    uint8_t size{0};
+    std::array<uint8_t, MaxBytes> bytes{};
+};
+
+struct MidiSharedDevice {
+    uint16_t index{0};
+    std::string name;
+};
+
+
+namespace MidiSharedBusLayout {
+    constexpr uint32_t Magic = 0x4D494442;   // "MIDB"
+    constexpr uint32_t Version = 1;
+    constexpr size_t MaxDevices = 64;
+    constexpr size_t NameWords = 8;          // 64 characters
+
+    struct Slot {
+        // 2 * seq + 1 while being written, 2 * seq + 2 once published
+        std::atomic<uint64_t> state;
+        std::atomic<int64_t> timestamp;
+        std::atomic<uint64_t> header;       // device | size << 16 | bytes 0-4 << 24
+        std::atomic<uint64_t> tail;         // bytes 5-12
+    };
+
+    struct Device {
+        std::atomic<uint32_t> active;
+        std::atomic<uint64_t> name[NameWords];
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tableSequence;
+        Device devices[MaxDevices];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs address free atomics");
+
+    inline size_t segmentSize(size_t capacity) noexcept {
+        return sizeof(Header) + capacity * sizeof(Slot);
+    }
+}
+
+
+class MidiSharedBusPublisher {
+public:
+    static constexpr size_t DefaultCapacity = 1 << 14;
+
+    // name is a POSIX shm name such as "/midirework". Capacity is rounded up to
+    // a power of two. Fails if a segment with that name already exists. Check
+    // isOpen(), failures are logged.
+    MidiSharedBusPublisher(std::string name, size_t capacity = DefaultCapacity);
+    ~MidiSharedBusPublisher();
+
+    MidiSharedBusPublisher(const MidiSharedBusPublisher&) = delete;
+    MidiSharedBusPublisher& operator=(const MidiSharedBusPublisher&) = delete;
+
+    bool isOpen() const noexcept;
+    const std::string& name() const noexcept;
+
+    // key identifies the source, usually the MidiDevice. False if the table is full.
+    bool addDevice(const void* key, std::string_view name);
+    void removeDevice(const void* key);
+
+    // Safe to call from any number of input threads. Messages longer than
+    // MidiSharedEvent::MaxBytes (SysEx) are not carried.
+    void publish(const void* key, const MidiMessage& msg);
+
+private:
+    int find(const void* key) const noexcept;
+    void writeTable(size_t index, bool active, std::string_view name);
+
+    std::string m_name;
+    void* m_memory{nullptr};
+    size_t m_size{0};
+
+    MidiSharedBusLayout::Header* m_header{nullptr};
+    MidiSharedBusLayout::Slot* m_slots{nullptr};
+    uint64_t m_mask{0};
+
+    std::mutex m_tableMutex;
+    std::array<std::atomic<const void*>, MidiSharedBusLayout::MaxDevices> m_keys{};
+};
+
+
+class MidiSharedBusReader {
+public:
+    explicit MidiSharedBusReader(std::string name);
+    ~MidiSharedBusReader();
+
+    MidiSharedBusReader(const MidiSharedBusReader&) = delete;
+    MidiSharedBusReader& operator=(const MidiSharedBusReader&) = delete;
+
+    bool isOpen() const noexcept;
+
+    std::vector<MidiSharedDevice> devices() const;
+
+    // Next event, false when the reader has caught up
+    bool read(MidiSharedEvent& event);
+
+    // Hands every pending event to fn, returns how many were read
+    template<typename Fn>
+    size_t poll(Fn&& fn, size_t max = SIZE_MAX) {
+        MidiSharedEvent event;
+        size_t count = 0;
+        while (count < max && read(event)) {
+            fn(event);
+            count++;
+        }
+        return count;
+    }
+
+    // Events overwritten before this reader got to them
+    uint64_t dropped() const noexcept;
+
+private:
+    void* m_memory{nullptr};
+    size_t m_size{0};
+
+    const MidiSharedBusLayout::Header* m_header{nullptr};
+    const MidiSharedBusLayout::Slot* m_slots{nullptr};
+    uint64_t m_mask{0};
+
+    uint64_t m_next{0};
+    uint64_t m_dropped{0};
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "types.h"
+
+class MidiTransport;
+
+
+template<typename T>
+using ChannelTable = std::array<std::array<T, 128>, 16>;
+
+struct MidiStatisticsSnapshot {
+    ChannelTable<uint32_t> noteCounts;          // note-ons per note
+    ChannelTable<uint32_t> velocityHistogram;   // note-on velocities
+    ChannelTable<uint32_t> controlChangeCounts;
+    ChannelTable<uint8_t> controlChangeValues;  // last value per controller
+
+    uint64_t totalEvents{0};
+    uint32_t eventsPerSecond{0};                // last full second, as of the snapshot
+    uint32_t peakEventsPerSecond{0};
+};
+
+
+// Per event aggregation, every update is O(1) into fixed tables. The input
+// thread is the only writer; snapshots use a sequence counter and retry if the
+// writer was active while copying, so they never block it.
+class MidiStatistics {
+public:
+    MidiStatistics(MidiTransport& transport);
+    ~MidiStatistics() = default;
+
+    void enable(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const noexcept { return m_enabled; }
+
+    void add(const MidiMessage& msg);
+
+    // Snapshots read as reset right away, the writer clears the counters on
+    // the next event.
+    void reset() { m_resetRequested = true; }
+
+    MidiStatisticsSnapshot snapshot() const;
+
+    void operator()(MidiMessage& msg);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void clearCounters();
+
+    MidiTransport& m_transport;
+    std::atomic<bool> m_enabled{false};
+    std::atomic<bool> m_resetRequested{false};
+
+    std::atomic<uint64_t> m_sequence{0};
+
+    ChannelTable<std::atomic<uint32_t>> m_noteCounts{};
+    ChannelTable<std::atomic<uint32_t>> m_velocityHistogram{};
+    ChannelTable<std::atomic<uint32_t>> m_controlChangeCounts{};
+    ChannelTable<std::atomic<uint8_t>> m_controlChangeValues{};
+
+    std::atomic<uint64_t> m_totalEvents{0};
+    std::atomic<uint32_t> m_eventsPerSecond{0};
+    std::atomic<uint32_t> m_peakEventsPerSecond{0};
+
+    // Written only by the input thread. Published so snapshot() can age the
+    // rate when no event comes to complete the second.
+    std::atomic<Clock::time_point> m_secondStart{};
+    std::atomic<uint32_t> m_currentSecondCount{0};
+};
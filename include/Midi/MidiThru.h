@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+
+class MidiDevice;
+
+
+// Forwards input from one device straight to another's output. Routes are
+// declared on the manager by handle and end with either device.
+struct MidiRoute {
+    // Bit per message type, see typeBit()
+    enum Types : uint8_t {
+        NoteOff         = 1 << 0,
+        NoteOn          = 1 << 1,
+        PolyPressure    = 1 << 2,
+        ControlChange   = 1 << 3,
+        ProgramChange   = 1 << 4,
+        ChannelPressure = 1 << 5,
+        PitchBend       = 1 << 6,
+        System          = 1 << 7,
+        AllTypes        = 0xFF
+    };
+
+    static constexpr uint16_t AllChannels = 0xFFFF;
+    static constexpr int8_t KeepChannel = -1;
+
+    MidiDeviceHandle from;
+    MidiDeviceHandle to;
+    uint16_t channels{AllChannels};     // bit per source channel
+    uint8_t types{AllTypes};
+    int8_t channel{KeepChannel};        // rewrites channel messages to 0-15
+
+    static uint8_t typeBit(uint8_t status) noexcept {
+        return status >= 0xF0 ? static_cast<uint8_t>(System) : static_cast<uint8_t>(1 << ((status >> 4) - 8));
+    }
+};
+
+struct MidiThruStats {
+    uint64_t forwarded{0};
+    uint64_t overBudget{0};
+    std::chrono::nanoseconds mean{0};
+    std::chrono::nanoseconds max{0};
+};
+
+
+// Routes of one source device, resolved to the target devices. Built by the
+// manager whenever routes or devices change and swapped in whole, so the input
+// thread never sees a half updated table.
+class MidiThruTable {
+public:
+    struct Target {
+        std::shared_ptr<MidiDevice> device;
+        uint16_t channels;
+        uint8_t types;
+        int8_t channel;
+    };
+
+    explicit MidiThruTable(std::vector<Target> targets);
+
+    // Sends msg to every matching target without allocating, returns how many
+    size_t forward(const MidiMessage& msg) const;
+
+    bool empty() const noexcept { return m_targets.empty(); }
+
+private:
+    std::vector<Target> m_targets;
+};
+
+
+// Time from a message reaching the device to the last thru send returning.
+// Written by the device's input thread only, read from anywhere.
+class MidiThruMeter {
+public:
+    static constexpr std::chrono::nanoseconds Budget = std::chrono::microseconds(100);
+
+    void record(std::chrono::nanoseconds elapsed) noexcept;
+    MidiThruStats stats() const noexcept;
+    void reset() noexcept;
+
+private:
+    std::atomic<uint64_t> m_forwarded{0};
+    std::atomic<uint64_t> m_overBudget{0};
+    std::atomic<int64_t> m_total{0};
+    std::atomic<int64_t> m_max{0};
+};
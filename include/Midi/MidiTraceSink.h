@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <readerwriterqueue.h>
+
+#include "types.h"
+
+// Raw event as it is stored in a trace file. Messages longer than the inline
+// bytes (SysEx) keep their real size but only the first bytes.
+struct MidiTraceRecord {
+    static constexpr size_t InlineBytes = 5;
+
+    int64_t timestamp;          // steady_clock nanoseconds
+    uint16_t device;
+    uint8_t size;               // saturates at 255
+    uint8_t bytes[InlineBytes];
+};
+static_assert(sizeof(MidiTraceRecord) == 16);
+
+
+// File layout: "MIDITRC1", then chunks of { uint32 kind, uint32 length, payload }.
+// A device chunk is a uint16 index followed by the name, an event chunk is an
+// array of MidiTraceRecord sorted by timestamp. Host byte order.
+namespace MidiTraceFormat {
+    constexpr char Magic[8] = { 'M', 'I', 'D', 'I', 'T', 'R', 'C', '1' };
+
+    enum ChunkKind : uint32_t {
+        DeviceChunk = 1,
+        EventChunk = 2
+    };
+}
+
+
+// Binary event log. Each device gets its own single producer queue so the
+// input thread only packs 16 bytes and enqueues them: no formatting, no locks
+// and no allocation. A background thread drains the queues and writes to the
+// file; formatting happens later, offline, with MidiTraceReader.
+class MidiTraceSink {
+public:
+    // Slots aren't reused, a reconnected device gets a new one
+    static constexpr size_t MaxDevices = 256;
+    static constexpr size_t DefaultQueueCapacity = 1 << 14;
+
+    MidiTraceSink(const std::string& path,
+                  std::chrono::milliseconds flushInterval = std::chrono::milliseconds(50),
+                  size_t queueCapacity = DefaultQueueCapacity);
+    ~MidiTraceSink();
+
+    MidiTraceSink(const MidiTraceSink&) = delete;
+    MidiTraceSink& operator=(const MidiTraceSink&) = delete;
+
+    bool isOpen() const noexcept;
+
+    // key identifies the source, usually the MidiDevice. False if the table is full.
+    bool addDevice(const void* key, std::string_view name);
+    void removeDevice(const void* key);
+
+    // Only the device's input thread may log for its key
+    void log(const void* key, const MidiMessage& msg) noexcept;
+
+    // Events lost because a queue was full
+    uint64_t dropped() const noexcept;
+
+    void stop();
+
+private:
+    using Queue = moodycamel::ReaderWriterQueue<MidiTraceRecord>;
+
+    int find(const void* key) const noexcept;
+    void run();
+    void drain(std::vector<MidiTraceRecord>& batch);
+    void writeChunk(uint32_t kind, const void* data, size_t size);
+
+    std::FILE* m_file{nullptr};
+    std::chrono::milliseconds m_flushInterval;
+    size_t m_queueCapacity;
+
+    std::array<std::unique_ptr<Queue>, MaxDevices> m_queueStorage;
+    std::array<std::atomic<Queue*>, MaxDevices> m_queues{};
+    std::array<std::atomic<const void*>, MaxDevices> m_keys{};
+    std::atomic<size_t> m_published{0};
+    std::atomic<uint64_t> m_dropped{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping{false};
+    size_t m_deviceCount{0};
+    std::vector<std::pair<uint16_t, std::string>> m_pendingDevices;
+
+    std::jthread m_thread;
+};
+
+
+class MidiTraceReader {
+public:
+    explicit MidiTraceReader(const std::string& path);
+
+    bool isOpen() const noexcept;
+
+    const std::vector<std::string>& devices() const noexcept;
+    const std::vector<MidiTraceRecord>& records() const noexcept;
+
+private:
+    bool m_open{false};
+    std::vector<std::string> m_devices;
+    std::vector<MidiTraceRecord> m_records;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "MidiRecordingIndex.h"
+
+
+// Structure-of-arrays block of events, one byte lane per field so a kernel
+// touches 32 events per AVX2 instruction. Messages longer than three bytes
+// (SysEx) are parked in `extended` and keep their slot with a 0xF0 status, which
+// no kernel touches.
+struct MidiEventBlock {
+    static constexpr uint8_t Extended = 0;
+
+    std::vector<int64_t> timestamp;
+    std::vector<uint8_t> status;
+    std::vector<uint8_t> data1;
+    std::vector<uint8_t> data2;
+    std::vector<uint8_t> length;        // 1-3 or Extended
+    std::vector<MidiMessage> extended;
+
+    size_t size() const noexcept { return status.size(); }
+    void reserve(size_t count);
+    void clear() noexcept;
+
+    void push(const MidiMessage& msg, int64_t time);
+    MidiMessage message(size_t index, size_t& extendedIndex) const;
+
+    // Works on a MidiRecordingSnapshot or any range of MidiMessageRecord
+    template<typename Range>
+    static MidiEventBlock fromRecords(const Range& records) {
+        MidiEventBlock block;
+        block.reserve(static_cast<size_t>(std::end(records) - std::begin(records)));
+        for (const MidiMessageRecord& record : records) {
+            block.push(record.message, record.timestamp);
+        }
+        return block;
+    }
+
+    std::vector<MidiMessageRecord> toRecords() const;
+};
+
+
+// Transpose, velocity curve, channel remap, key splits and controller scaling
+// as one stage. Applied in that fixed order: splits see the played note, the
+// channel map sees the split channel.
+//
+// Built once and shared read-only, MidiDevice takes it as a shared_ptr to
+// const so it can be swapped while input runs. The per-message path runs the
+// same kernels on a block of one.
+class MidiTransform {
+public:
+    using Curve = std::array<uint8_t, 128>;
+
+    struct Split {
+        uint8_t low;
+        uint8_t high;
+        uint8_t channel;        // 0-15
+    };
+
+    MidiTransform();
+
+    void setTranspose(int8_t semitones) noexcept;
+    void setVelocityCurve(const Curve& curve) noexcept;
+    // 127 * (v / 127) ^ exponent, below 1 lifts soft playing
+    void setVelocityCurve(float exponent) noexcept;
+    void setChannelMap(const std::array<uint8_t, 16>& map) noexcept;
+    void addSplit(Split split);
+    // Maps the controller's 0-127 range onto min-max, min > max inverts it
+    void scaleController(uint8_t controller, uint8_t min, uint8_t max);
+
+    bool isIdentity() const noexcept;
+
+    void apply(MidiEventBlock& block) const;
+    void apply(MidiMessage& msg) const;
+    std::vector<MidiMessageRecord> apply(const MidiRecordingSnapshot& snapshot) const;
+
+    void operator()(MidiMessage& msg) const { apply(msg); }
+
+private:
+    struct ControllerScale {
+        uint8_t controller;
+        Curve curve;
+    };
+
+    void apply(uint8_t* status, uint8_t* data1, uint8_t* data2, size_t count) const;
+
+    int8_t m_transpose{0};
+    bool m_curveSet{false};
+    Curve m_velocityCurve{};
+    bool m_channelMapSet{false};
+    std::array<uint8_t, 16> m_channelMap{};
+    std::vector<Split> m_splits;
+    std::vector<ControllerScale> m_controllerScales;
+};
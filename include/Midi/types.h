@@ -1,6 +1,7 @@
 #pragma once
 #include <libremidi/libremidi.hpp>
 #include <chrono>
+#include <cstdint>
 #include <source_location>
 
 enum class Availability {
@@ -12,6 +13,49 @@ enum class Availability {
     TimedOut
 };
 
+enum class RecordingMode {
+    Full,
+    Compressed
+};
+
+// Stable device id. The index is dense and reused after a device goes away,
+// the generation tells a stale handle from the device now in its slot.
+struct MidiDeviceHandle {
+    static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+    uint32_t index{InvalidIndex};
+    uint32_t generation{0};
+
+    bool valid() const noexcept { return index != InvalidIndex; }
+    uint64_t value() const noexcept { return (static_cast<uint64_t>(generation) << 32) | index; }
+
+    friend bool operator==(const MidiDeviceHandle&, const MidiDeviceHandle&) = default;
+};
+
+enum class MidiHighResType : uint8_t {
+    ControlChange,      // 14-bit controller, number is the MSB controller 0-31
+    NRPN,
+    RPN,
+    PitchBend,
+    Pressure,           // MPE per-note channel pressure
+    Timbre              // MPE per-note CC74
+};
+
+// One logical change assembled from up to four channel messages. Values are
+// 14-bit; pressure and timbre are 7-bit at the source and scaled so 127 maps
+// to 16383. An MSB is reported as soon as it arrives, a following LSB reports
+// the same change again with the full value and `refinement` set.
+struct MidiHighResEvent {
+    static constexpr int8_t NoNote = -1;
+
+    MidiHighResType type{MidiHighResType::ControlChange};
+    uint8_t channel{0};         // 0-15
+    uint16_t number{0};         // controller or 14-bit parameter number
+    uint16_t value{0};
+    int8_t note{NoNote};        // note playing on an MPE member channel
+    bool refinement{false};     // LSB completing the previous event's value
+};
+
 struct MidiMessageRecord {
     libremidi::message message;
     int64_t timestamp;
@@ -19,10 +63,14 @@ struct MidiMessageRecord {
 
 using MidiMessage = libremidi::message;
 using MidiMessageCallback = std::function<void(MidiMessage&)>;
+using MidiMessageFilter = std::function<bool(const MidiMessage&)>;
 using DeviceMidiMessageCallback = std::function<void(class MidiDevice*, MidiMessage&)>;
+using HighResEventCallback = std::function<void(const MidiHighResEvent&)>;
+using DeviceHighResEventCallback = std::function<void(class MidiDevice*, const MidiHighResEvent&)>;
 using DeviceRefreshCallback = std::function<void(std::vector<class MidiDevice*>)>;
 using DeviceAddedCallback = std::function<void(class MidiDevice*)>;
 using DeviceRemovedCallback = std::function<void(class MidiDevice*)>;
+using DeviceStalledCallback = std::function<void(class MidiDevice*, bool stalled)>;
 
 using ErrorCallback = std::function<void(std::string_view, const std::source_location&)>;
 using WarningCallback = std::function<void(std::string_view, const std::source_location&)>;
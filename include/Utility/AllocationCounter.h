@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+// Counts heap allocations made while an AllocationScope is active on the
+// calling thread. Wrap a real-time path in a scope, run it to steady state,
+// reset() and check that total() stays at zero.
+//
+// Counting replaces the global operator new, so it only exists in builds with
+// MIDIREWORK_COUNT_ALLOCATIONS. Otherwise scopes are empty and total() is zero.
+namespace AllocationCounter {
+    struct Counts {
+        uint64_t allocations{0};
+        uint64_t bytes{0};
+    };
+
+#ifdef MIDIREWORK_COUNT_ALLOCATIONS
+    constexpr bool Enabled = true;
+
+    Counts total() noexcept;
+    void reset() noexcept;
+
+    void enterScope() noexcept;
+    void exitScope() noexcept;
+    bool inScope() noexcept;
+
+    // Leaves every scope on this thread, returns what resumeScope() restores
+    int suspendScope() noexcept;
+    void resumeScope(int depth) noexcept;
+#else
+    constexpr bool Enabled = false;
+
+    inline Counts total() noexcept { return {}; }
+    inline void reset() noexcept {}
+
+    inline void enterScope() noexcept {}
+    inline void exitScope() noexcept {}
+    inline bool inScope() noexcept { return false; }
+
+    inline int suspendScope() noexcept { return 0; }
+    inline void resumeScope(int) noexcept {}
+#endif
+}
+
+class AllocationScope {
+public:
+    AllocationScope() noexcept { AllocationCounter::enterScope(); }
+    ~AllocationScope() { AllocationCounter::exitScope(); }
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+};
+
+// Inside a scope, marks a path documented as outside the real-time guarantee
+// (thru sends, recording) so it isn't counted
+class AllocationScopeExemption {
+public:
+    AllocationScopeExemption() noexcept : m_depth(AllocationCounter::suspendScope()) {}
+    ~AllocationScopeExemption() { AllocationCounter::resumeScope(m_depth); }
+
+    AllocationScopeExemption(const AllocationScopeExemption&) = delete;
+    AllocationScopeExemption& operator=(const AllocationScopeExemption&) = delete;
+
+private:
+    int m_depth;
+};
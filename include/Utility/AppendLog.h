@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Chunked append-only log with a single writer. Chunks are never moved or
+// reallocated once published, so a snapshot can keep reading the entries that
+// existed when it was taken while the writer keeps appending. Snapshots share
+// the chunks by reference count; nothing is copied and the writer never waits.
+// Chunks come from the given memory resource, which has to be thread safe if
+// snapshots can outlive the writer's thread.
+template<typename T, size_t ChunkSize = 1024>
+class AppendLog {
+    struct Chunk {
+        std::array<T, ChunkSize> items;
+    };
+
+    struct State {
+        explicit State(std::pmr::memory_resource* resource) : chunks(resource) {}
+
+        std::pmr::vector<std::shared_ptr<Chunk>> chunks;
+        std::atomic<size_t> size{0};
+    };
+
+    static const T& at(const State* state, size_t i) {
+        return state->chunks[i / ChunkSize]->items[i % ChunkSize];
+    }
+
+public:
+    class Snapshot {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            iterator() = default;
+            iterator(const State* state, size_t index) : m_state(state), m_index(index) {}
+
+            reference operator*() const { return at(m_state, m_index); }
+            pointer operator->() const { return &at(m_state, m_index); }
+            reference operator[](difference_type n) const { return at(m_state, m_index + n); }
+
+            iterator& operator++() { ++m_index; return *this; }
+            iterator operator++(int) { iterator tmp = *this; ++m_index; return tmp; }
+            iterator& operator--() { --m_index; return *this; }
+            iterator operator--(int) { iterator tmp = *this; --m_index; return tmp; }
+            iterator& operator+=(difference_type n) { m_index += n; return *this; }
+            iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+            friend iterator operator+(iterator it, difference_type n) { return it += n; }
+            friend iterator operator+(difference_type n, iterator it) { return it += n; }
+            friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+            friend difference_type operator-(const iterator& a, const iterator& b) {
+                return static_cast<difference_type>(a.m_index) - static_cast<difference_type>(b.m_index);
+            }
+            friend bool operator==(const iterator& a, const iterator& b) { return a.m_index == b.m_index; }
+            friend auto operator<=>(const iterator& a, const iterator& b) { return a.m_index <=> b.m_index; }
+
+        private:
+            const State* m_state{nullptr};
+            size_t m_index{0};
+        };
+
+        Snapshot() = default;
+
+        const T& operator[](size_t i) const { return at(m_state.get(), i); }
+
+        size_t size() const noexcept { return m_size; }
+        bool empty() const noexcept { return m_size == 0; }
+
+        iterator begin() const { return iterator(m_state.get(), 0); }
+        iterator end() const { return iterator(m_state.get(), m_size); }
+
+        const T& front() const { return (*this)[0]; }
+        const T& back() const { return (*this)[m_size - 1]; }
+
+    private:
+        friend class AppendLog;
+
+        Snapshot(std::shared_ptr<const State> state, size_t size)
+            : m_state(std::move(state))
+            , m_size(size)
+        {
+        }
+
+        std::shared_ptr<const State> m_state;
+        size_t m_size{0};
+    };
+
+    explicit AppendLog(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_resource(resource)
+        , m_current(makeState())
+        , m_state(m_current)
+    {
+    }
+
+    AppendLog(const AppendLog&) = delete;
+    AppendLog& operator=(const AppendLog&) = delete;
+
+    // Writer side, must not be called concurrently with itself or clear().
+    void push_back(T value) {
+        const size_t size = m_current->size.load(std::memory_order_relaxed);
+
+        if (size == m_current->chunks.size() * ChunkSize) {
+            auto next = makeState();
+            next->chunks.reserve(m_current->chunks.size() + 1);
+            next->chunks = m_current->chunks;
+            next->chunks.push_back(std::allocate_shared<Chunk>(std::pmr::polymorphic_allocator<Chunk>(m_resource)));
+            next->size.store(size, std::memory_order_relaxed);
+
+            m_current = next;
+            m_state.store(std::move(next), std::memory_order_release);
+        }
+
+        m_current->chunks[size / ChunkSize]->items[size % ChunkSize] = std::move(value);
+        m_current->size.store(size + 1, std::memory_order_release);
+    }
+
+    void clear() {
+        m_current = makeState();
+        m_state.store(m_current, std::memory_order_release);
+    }
+
+    Snapshot snapshot() const {
+        std::shared_ptr<const State> state = m_state.load(std::memory_order_acquire);
+        const size_t size = state->size.load(std::memory_order_acquire);
+        return Snapshot(std::move(state), size);
+    }
+
+    size_t size() const noexcept {
+        return m_state.load(std::memory_order_acquire)->size.load(std::memory_order_acquire);
+    }
+
+    std::pmr::memory_resource* resource() const noexcept { return m_resource; }
+
+private:
+    std::shared_ptr<State> makeState() const {
+        return std::allocate_shared<State>(std::pmr::polymorphic_allocator<State>(m_resource), m_resource);
+    }
+
+    std::pmr::memory_resource* m_resource;
+
+    // m_current is only touched by the writer, readers go through m_state.
+    std::shared_ptr<State> m_current;
+    std::atomic<std::shared_ptr<State>> m_state;
+};
@@ -1,10 +1,23 @@
 #pragma once
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
 #include <atomic>
+#include <tuple>
+
+#include "SpanTracer.h"
+
+struct DebounceOptions {
+    // Fire on the first trigger of a burst instead of waiting for it to settle
+    bool leading{false};
+    // Fire once the burst has been quiet for the delay
+    bool trailing{true};
+    // Upper bound on how long a burst can postpone the trailing call, zero for none
+    std::chrono::milliseconds maxWait{0};
+};
 
 template<typename... Args>
 class Debouncer {
@@ -12,11 +25,10 @@ public:
     using Callback = std::function<void(Args...)>;
     using Clock = std::chrono::steady_clock;
 
-    Debouncer(std::chrono::milliseconds delay, std::function<void(Args...)> cb) 
+    Debouncer(std::chrono::milliseconds delay, std::function<void(Args...)> cb, DebounceOptions options = {})
         : m_delay(delay)
         , m_cb(std::move(cb))
-        , m_cancelled(false)
-        , m_running(false)
+        , m_options(options)
     {
     }
 
@@ -24,50 +36,56 @@ public:
         stop();
     }
 
+    // Never blocks on the callback, it always runs on the debouncer's thread
     void trigger(Args... args) {
-        {
-            std::lock_guard lk(m_mutex);
-            m_lastArgs = std::make_tuple(std::forward<Args>(args)...);
-            m_cancelled = true;
-            m_cv.notify_one();
-        }
+        TraceSpan span("debouncer.trigger");
+        std::lock_guard lk(m_mutex);
+        const auto now = Clock::now();
 
-        if (m_timerThread.joinable()) {
-            m_timerThread.join();
-        }
+        // The trace links the last trigger of a burst to the call it causes
+        m_traceId = SpanTracer::nextId();
+        SpanTracer::flowStart("debounce", m_traceId);
 
-        {
-            std::lock_guard lk(m_mutex);
-            m_cancelled = false;
-            m_running   = true;
+        m_lastArgs = std::make_tuple(std::forward<Args>(args)...);
+
+        if (!m_active) {
+            m_active = true;
+            m_burstStart = now;
+            m_fireLeading = m_options.leading;
+            m_pending = !m_options.leading;
+        } else {
+            m_pending = true;
         }
 
-        m_timerThread = std::jthread([this] {
-            std::unique_lock lk(m_mutex);
-            auto deadline = Clock::now() + m_delay;
+        m_deadline = now + m_delay;
+        if (m_options.maxWait > std::chrono::milliseconds::zero()) {
+            m_deadline = std::min(m_deadline, m_burstStart + m_options.maxWait);
+        }
 
-            while (!m_cancelled) {
-                if (m_cv.wait_until(lk, deadline) == std::cv_status::timeout) {
-                    break;
-                }
-            }
+        if (!m_timerThread.joinable()) {
+            m_stopping = false;
+            m_timerThread = std::jthread([this] { run(); });
+        }
+        m_cv.notify_one();
+    }
 
-            if (!m_cancelled) {
-                auto argsCopy = m_lastArgs;
-                m_running = false;
-                lk.unlock();
-                std::apply(m_cb, argsCopy);
-            } else {
-                m_running = false;
-            }
-        });
+    // Drops a pending call without stopping the thread
+    void cancel() {
+        std::lock_guard lk(m_mutex);
+        m_active = false;
+        m_pending = false;
+        m_fireLeading = false;
+        m_cv.notify_one();
     }
 
     void stop() {
+        TraceSpan span("debouncer.stop");
         {
             std::lock_guard lk(m_mutex);
-            m_cancelled = true;
-            m_running   = false;
+            m_stopping = true;
+            m_active = false;
+            m_pending = false;
+            m_fireLeading = false;
             m_cv.notify_one();
         }
         if (m_timerThread.joinable()) {
@@ -75,13 +93,61 @@ public:
         }
     }
 private:
+    void run() {
+        SpanTracer::nameThread("debouncer");
+        std::unique_lock lk(m_mutex);
+
+        while (!m_stopping) {
+            if (m_fireLeading) {
+                m_fireLeading = false;
+                invoke(lk);
+                continue;
+            }
+
+            if (!m_active) {
+                m_cv.wait(lk);
+                continue;
+            }
+
+            if (Clock::now() < m_deadline) {
+                m_cv.wait_until(lk, m_deadline);
+                continue;
+            }
+
+            // Burst is over, the next trigger starts a new one
+            m_active = false;
+            if (m_pending && m_options.trailing) {
+                m_pending = false;
+                invoke(lk);
+            }
+        }
+    }
+
+    void invoke(std::unique_lock<std::mutex>& lk) {
+        auto argsCopy = m_lastArgs;
+        const uint64_t traceId = m_traceId;
+        lk.unlock();
+        {
+            TraceSpan span("debouncer.fire", traceId);
+            SpanTracer::flowEnd("debounce", traceId);
+            std::apply(m_cb, argsCopy);
+        }
+        lk.lock();
+    }
+
     std::chrono::milliseconds m_delay;
     Callback m_cb;
+    DebounceOptions m_options;
     std::mutex m_mutex;
     std::condition_variable m_cv;
     std::jthread m_timerThread;
 
-    bool m_cancelled;
-    bool m_running;
+    bool m_stopping{false};
+    bool m_active{false};
+    bool m_pending{false};
+    bool m_fireLeading{false};
+    Clock::time_point m_burstStart;
+    Clock::time_point m_deadline;
     std::tuple<Args...> m_lastArgs;
-};
\ No newline at end of file
+    uint64_t m_traceId{0};
+};
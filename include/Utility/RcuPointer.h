@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Shared pointer the input threads read without locks or reference counting.
+// std::atomic<std::shared_ptr> isn't lock-free in libstdc++, every load takes
+// an internal spin lock shared with the writers.
+//
+// A reader registers in the current epoch, loads the raw pointer and leaves
+// when its guard is destroyed. A writer publishes the new pointer, then flips
+// the epoch and waits for each epoch's readers to leave before it releases the
+// old value. Readers never wait; a writer waits for at most the read sections
+// that were already running, so keep them short and never store() to a
+// pointer while holding a guard on it.
+template<typename T>
+class RcuPointer {
+public:
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const RcuPointer& owner) noexcept
+            : m_owner(owner)
+            , m_epoch(owner.m_epoch.load() & 1)
+        {
+            owner.m_readers[m_epoch].fetch_add(1);
+            m_value = owner.m_value.load();
+        }
+
+        ~ReadGuard() {
+            m_owner.m_readers[m_epoch].fetch_sub(1, std::memory_order_release);
+        }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        T* get() const noexcept { return m_value; }
+        T* operator->() const noexcept { return m_value; }
+        T& operator*() const noexcept { return *m_value; }
+        explicit operator bool() const noexcept { return m_value != nullptr; }
+
+    private:
+        const RcuPointer& m_owner;
+        uint32_t m_epoch;
+        T* m_value;
+    };
+
+    RcuPointer() = default;
+
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator=(const RcuPointer&) = delete;
+
+    ReadGuard read() const noexcept {
+        return ReadGuard(*this);
+    }
+
+    // For threads that may block, keeps the value alive on its own
+    std::shared_ptr<T> load() const {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        return m_owned;
+    }
+
+    // Returns the previous value once no reader can still see it
+    std::shared_ptr<T> exchange(std::shared_ptr<T> value) {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_value.store(value.get());
+        synchronize();
+        std::swap(m_owned, value);
+        return value;
+    }
+
+    void store(std::shared_ptr<T> value) {
+        exchange(std::move(value));
+    }
+
+private:
+    // Two flips so a reader that read the epoch just before a flip is still
+    // waited for, whichever counter it registered in
+    void synchronize() const {
+        for (int phase = 0; phase < 2; phase++) {
+            const uint32_t previous = m_epoch.fetch_add(1) & 1;
+            while (m_readers[previous].load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::atomic<T*> m_value{nullptr};
+    mutable std::atomic<uint32_t> m_epoch{0};
+    mutable std::array<std::atomic<uint32_t>, 2> m_readers{};
+
+    mutable std::mutex m_writeMutex;
+    std::shared_ptr<T> m_owned;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+#include "AllocationCounter.h"
+
+// Counts what a real-time thread must not do while an AllocationScope is
+// active on it: heap allocations (from AllocationCounter) and blocking locks.
+// Run the path to steady state, reset() and check that total() stays clean.
+//
+// Lock counting interposes pthread_mutex_lock and the rwlock lock calls, so it
+// only exists in Linux builds with MIDIREWORK_REALTIME_CHECKS, which also
+// turns on allocation counting.
+namespace RealtimeChecker {
+    struct Violations {
+        uint64_t allocations{0};
+        uint64_t locks{0};
+
+        bool clean() const noexcept { return allocations == 0 && locks == 0; }
+    };
+
+#if defined(MIDIREWORK_REALTIME_CHECKS) && defined(__linux__)
+    constexpr bool Enabled = true;
+
+    Violations total() noexcept;
+    void reset() noexcept;
+#else
+    constexpr bool Enabled = false;
+
+    inline Violations total() noexcept { return {}; }
+    inline void reset() noexcept {}
+#endif
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Timed spans on the hot paths, written as Chrome trace event JSON so one
+// event's way across the input, observer and debouncer threads can be read in
+// chrome://tracing or ui.perfetto.dev.
+//
+// Every thread records into its own fixed ring: a span costs two clock reads
+// and a few stores, no locks. A full ring overwrites its oldest spans, so the
+// trace always ends with the most recent activity. The first span on a thread
+// takes a buffer, allocating one unless a finished thread left one behind, so
+// warm real-time threads up first.
+//
+// Only exists in builds with MIDIREWORK_ENABLE_TRACING, otherwise every call
+// is empty and compiles away.
+namespace SpanTracer {
+    constexpr size_t BufferCapacity = 1 << 15;
+
+#ifdef MIDIREWORK_ENABLE_TRACING
+    constexpr bool Enabled = true;
+
+    int64_t now() noexcept;
+
+    // name must be a string literal, only the pointer is kept
+    void complete(const char* name, int64_t start, uint64_t id) noexcept;
+    void instant(const char* name, uint64_t id) noexcept;
+
+    // Arrows between spans on different threads, matched by id
+    void flowStart(const char* name, uint64_t id) noexcept;
+    void flowEnd(const char* name, uint64_t id) noexcept;
+    uint64_t nextId() noexcept;
+
+    void nameThread(std::string_view name);
+
+    // Writes everything recorded so far. Spans still being recorded while it
+    // runs may or may not be included.
+    bool writeChromeTrace(const std::string& path);
+    uint64_t overwritten();
+#else
+    constexpr bool Enabled = false;
+
+    inline int64_t now() noexcept { return 0; }
+
+    inline void complete(const char*, int64_t, uint64_t) noexcept {}
+    inline void instant(const char*, uint64_t) noexcept {}
+
+    inline void flowStart(const char*, uint64_t) noexcept {}
+    inline void flowEnd(const char*, uint64_t) noexcept {}
+    inline uint64_t nextId() noexcept { return 0; }
+
+    inline void nameThread(std::string_view) {}
+
+    inline bool writeChromeTrace(const std::string&) { return false; }
+    inline uint64_t overwritten() { return 0; }
+#endif
+}
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, uint64_t id = 0) noexcept
+        : m_name(name)
+        , m_id(id)
+        , m_start(SpanTracer::now())
+    {
+    }
+
+    ~TraceSpan() { SpanTracer::complete(m_name, m_start, m_id); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_id;
+    int64_t m_start;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One thread running any number of one-shot and periodic timers, so features
+// that need a timer don't each start their own thread.
+class TimerScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+    using TimerId = uint64_t;
+
+    TimerScheduler()
+        : m_thread([this] { run(); })
+    {
+    }
+
+    ~TimerScheduler() {
+        stop();
+    }
+
+    TimerScheduler(const TimerScheduler&) = delete;
+    TimerScheduler& operator=(const TimerScheduler&) = delete;
+
+    TimerId after(Clock::duration delay, Task task) {
+        return add(delay, Clock::duration::zero(), std::move(task));
+    }
+
+    TimerId every(Clock::duration interval, Task task) {
+        return add(interval, interval, std::move(task));
+    }
+
+    // Once it returns the task won't run again and isn't running, so whatever
+    // it uses can be destroyed. Don't hold a lock the task takes while calling
+    // it. From inside a task, including the one being cancelled, it only
+    // removes the timer, a task can't wait for itself.
+    void cancel(TimerId id) {
+        std::unique_lock lk(m_mutex);
+        m_tasks.erase(id);
+        if (std::this_thread::get_id() != m_thread.get_id()) {
+            m_idle.wait(lk, [this, id] { return m_running != id; });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard lk(m_mutex);
+            m_stopping = true;
+            m_cv.notify_one();
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+private:
+    struct Timer {
+        Clock::time_point due;
+        TimerId id;
+        Clock::duration interval;
+    };
+
+    struct Later {
+        bool operator()(const Timer& a, const Timer& b) const noexcept {
+            return a.due > b.due;
+        }
+    };
+
+    TimerId add(Clock::duration delay, Clock::duration interval, Task task) {
+        std::lock_guard lk(m_mutex);
+        const TimerId id = m_nextId++;
+        m_tasks.emplace(id, std::move(task));
+        m_timers.push({ Clock::now() + delay, id, interval });
+        m_cv.notify_one();
+        return id;
+    }
+
+    void run() {
+        std::unique_lock lk(m_mutex);
+
+        while (!m_stopping) {
+            if (m_timers.empty()) {
+                m_cv.wait(lk);
+                continue;
+            }
+
+            // A new timer or stop can wake us early, so re-check after waiting
+            const auto due = m_timers.top().due;
+            if (Clock::now() < due) {
+                m_cv.wait_until(lk, due);
+                continue;
+            }
+
+            const Timer next = m_timers.top();
+            m_timers.pop();
+
+            auto it = m_tasks.find(next.id);
+            if (it == m_tasks.end()) {
+                continue;
+            }
+
+            Task task = it->second;
+            m_running = next.id;
+            lk.unlock();
+            task();
+            lk.lock();
+            m_running = 0;
+            m_idle.notify_all();
+
+            if (next.interval != Clock::duration::zero() && m_tasks.contains(next.id)) {
+                // Skip missed periods rather than firing them back to back
+                const auto due = std::max(next.due + next.interval, Clock::now());
+                m_timers.push({ due, next.id, next.interval });
+            } else {
+                m_tasks.erase(next.id);
+            }
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_idle;
+    bool m_stopping{false};
+    TimerId m_running{0};
+
+    std::priority_queue<Timer, std::vector<Timer>, Later> m_timers;
+    std::unordered_map<TimerId, Task> m_tasks;
+    TimerId m_nextId{1};
+
+    std::jthread m_thread;
+};
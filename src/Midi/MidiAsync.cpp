@@ -0,0 +1,18 @@
+#include "Midi/MidiAsync.h"
+#include <spdlog/spdlog.h>
+
+
+TimerScheduler& MidiAsync::timers() {
+    static TimerScheduler scheduler;
+    return scheduler;
+}
+
+void MidiAsync::reportUnhandled(std::exception_ptr exception) noexcept {
+    try {
+        std::rethrow_exception(exception);
+    } catch (const std::exception& e) {
+        spdlog::error("Detached MIDI task failed: {}", e.what());
+    } catch (...) {
+        spdlog::error("Detached MIDI task failed with an unknown exception");
+    }
+}
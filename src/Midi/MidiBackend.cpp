@@ -0,0 +1,81 @@
+#include "Midi/MidiBackend.h"
+#include <algorithm>
+
+
+libremidi::API MidiBackends::api(MidiBackend backend) noexcept {
+    switch (backend) {
+        case MidiBackend::AlsaSequencer: return libremidi::API::ALSA_SEQ;
+        case MidiBackend::AlsaRaw:       return libremidi::API::ALSA_RAW;
+        case MidiBackend::Jack:          return libremidi::API::JACK_MIDI;
+        case MidiBackend::Dummy:         return libremidi::API::DUMMY;
+        default:                         return libremidi::API::UNSPECIFIED;
+    }
+}
+
+std::string_view MidiBackends::name(MidiBackend backend) noexcept {
+    switch (backend) {
+        case MidiBackend::AlsaSequencer: return "ALSA sequencer";
+        case MidiBackend::AlsaRaw:       return "ALSA raw";
+        case MidiBackend::Jack:          return "JACK";
+        case MidiBackend::Dummy:         return "Dummy";
+        default:                         return "Default";
+    }
+}
+
+bool MidiBackends::isAvailable(MidiBackend backend) {
+    if (backend == MidiBackend::Default) {
+        return true;
+    }
+    const auto apis = libremidi::available_apis();
+    return std::find(apis.begin(), apis.end(), api(backend)) != apis.end();
+}
+
+bool MidiBackends::ownsInputThread(MidiBackend backend) noexcept {
+    switch (backend) {
+        case MidiBackend::AlsaSequencer:
+        case MidiBackend::AlsaRaw:
+        case MidiBackend::Dummy:
+            return true;
+        case MidiBackend::Jack:
+            return false;
+        default:
+#if defined(__linux__)
+            return true;        // ALSA sequencer
+#else
+            return false;
+#endif
+    }
+}
+
+std::vector<MidiBackend> MidiBackends::available() {
+    std::vector<MidiBackend> result;
+    for (auto backend : { MidiBackend::AlsaSequencer, MidiBackend::AlsaRaw, MidiBackend::Jack, MidiBackend::Dummy }) {
+        if (isAvailable(backend)) {
+            result.push_back(backend);
+        }
+    }
+    return result;
+}
+
+// Default keeps the single argument constructors so libremidi picks exactly
+// what it did before backends were selectable
+libremidi::midi_in MidiBackends::makeInput(const libremidi::input_configuration& config, MidiBackend backend) {
+    if (backend == MidiBackend::Default) {
+        return libremidi::midi_in(config);
+    }
+    return libremidi::midi_in(config, libremidi::midi_in_configuration_for(api(backend)));
+}
+
+libremidi::midi_out MidiBackends::makeOutput(const libremidi::output_configuration& config, MidiBackend backend) {
+    if (backend == MidiBackend::Default) {
+        return libremidi::midi_out(config);
+    }
+    return libremidi::midi_out(config, libremidi::midi_out_configuration_for(api(backend)));
+}
+
+libremidi::observer MidiBackends::makeObserver(const libremidi::observer_configuration& config, MidiBackend backend) {
+    if (backend == MidiBackend::Default) {
+        return libremidi::observer(config);
+    }
+    return libremidi::observer(config, libremidi::observer_configuration_for(api(backend)));
+}
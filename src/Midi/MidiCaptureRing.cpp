@@ -0,0 +1,107 @@
+#include "Midi/MidiCaptureRing.h"
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+
+namespace {
+    // payload layout: [63..32] sequence | [25..24] size | [23..0] bytes
+    uint64_t pack(const MidiMessage& msg, uint64_t sequence) noexcept {
+        uint64_t payload = (sequence & 0xFFFFFFFF) << 32;
+        payload |= static_cast<uint64_t>(msg.size()) << 24;
+        for (size_t i = 0; i < msg.size(); i++) {
+            payload |= static_cast<uint64_t>(msg[i]) << (16 - 8 * i);
+        }
+        return payload;
+    }
+}
+
+
+MidiCaptureRing::MidiCaptureRing(size_t capacity)
+    : m_slots(std::make_unique<Slot[]>(std::bit_ceil(std::max<size_t>(capacity, 2))))
+    , m_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+{
+}
+
+void MidiCaptureRing::add(const MidiMessage& msg) noexcept {
+    if (msg.size() == 0 || msg.size() > 3) {
+        return;
+    }
+
+    const uint64_t index = m_head.load(std::memory_order_relaxed);
+    Slot& slot = m_slots[index & m_mask];
+
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    slot.payload.store(InvalidPayload, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestamp.store(now, std::memory_order_relaxed);
+    slot.payload.store(pack(msg, index), std::memory_order_release);
+
+    m_head.store(index + 1, std::memory_order_release);
+}
+
+std::vector<MidiMessageRecord> MidiCaptureRing::snapshot() const {
+    return snapshot(std::chrono::milliseconds::max());
+}
+
+std::vector<MidiMessageRecord> MidiCaptureRing::snapshot(std::chrono::milliseconds window) const {
+    struct Entry {
+        int64_t timestamp;
+        uint64_t payload;
+    };
+
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    const uint64_t first = head > capacity() ? head - capacity() : 0;
+
+    // The window ends now, not at the newest event, so a quiet device returns
+    // nothing rather than its last burst
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const int64_t cutoff = window == std::chrono::milliseconds::max()
+        ? std::numeric_limits<int64_t>::min()
+        : std::chrono::duration_cast<std::chrono::nanoseconds>(now - window).count();
+
+    // Walk backwards from the newest event so we can stop at the window edge.
+    std::vector<Entry> entries;
+
+    for (uint64_t i = head; i-- > first;) {
+        const Slot& slot = m_slots[i & m_mask];
+
+        const uint64_t before = slot.payload.load(std::memory_order_acquire);
+        const int64_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = slot.payload.load(std::memory_order_relaxed);
+
+        // Overwritten by the writer since we read the head, so is everything older.
+        if (before != after || (before >> 32) != (i & 0xFFFFFFFF)) {
+            break;
+        }
+
+        if (timestamp < cutoff) {
+            break;
+        }
+
+        entries.push_back({ timestamp, before });
+    }
+
+    std::vector<MidiMessageRecord> result;
+    result.reserve(entries.size());
+
+    const int64_t base = entries.empty() ? 0 : entries.back().timestamp;
+
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        const size_t size = (it->payload >> 24) & 0x3;
+
+        MidiMessageRecord record;
+        for (size_t b = 0; b < size; b++) {
+            record.message.bytes.push_back(static_cast<unsigned char>(it->payload >> (16 - 8 * b)));
+        }
+        record.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::nanoseconds(it->timestamp - base)).count();
+
+        result.push_back(std::move(record));
+    }
+
+    return result;
+}
@@ -0,0 +1,178 @@
+#include "Midi/MidiClockTracker.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+    // A gap this many periods long means the clock source restarted
+    constexpr double ResyncPeriods = 4.0;
+    constexpr size_t MinimumTicks = 6;
+
+    int64_t steadyNow() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+
+MidiClockTracker::MidiClockTracker(MidiTransport& transport)
+    : m_transport(transport)
+{
+}
+
+bool MidiClockTracker::isClockMessage(const MidiMessage& msg) noexcept {
+    if (msg.size() == 0) {
+        return false;
+    }
+
+    switch (msg[0]) {
+        case 0xF8: case 0xFA: case 0xFB: case 0xFC:
+            return true;
+        case 0xF2:
+            return msg.size() == 3;
+        default:
+            return false;
+    }
+}
+
+void MidiClockTracker::add(const MidiMessage& msg) {
+    if (!isClockMessage(msg)) {
+        return;
+    }
+
+    const int64_t local = steadyNow();
+
+    switch (msg[0]) {
+        case 0xF8:
+            tick(msg.timestamp != 0 ? msg.timestamp : local, local);
+            break;
+        case 0xFA:
+            m_current.state = MidiTransportState::Playing;
+            m_current.ticks = 0;
+            break;
+        case 0xFB:
+            m_current.state = MidiTransportState::Playing;
+            break;
+        case 0xFC:
+            m_current.state = MidiTransportState::Stopped;
+            break;
+        case 0xF2:
+            // Song position counts sixteenth notes, six ticks each
+            m_current.ticks = static_cast<uint64_t>((msg[1] & 0x7F) | ((msg[2] & 0x7F) << 7)) * 6;
+            break;
+    }
+
+    publish();
+}
+
+MidiClockState MidiClockTracker::state() const {
+    MidiClockState result;
+
+    for (;;) {
+        const uint64_t before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        result.state = m_state.load(std::memory_order_relaxed);
+        result.ticks = m_ticks.load(std::memory_order_relaxed);
+        result.bpm = m_bpm.load(std::memory_order_relaxed);
+        result.tickPeriod = m_tickPeriod.load(std::memory_order_relaxed);
+        result.jitter = m_jitter.load(std::memory_order_relaxed);
+        result.lastTick = m_lastTick.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) == before) {
+            return result;
+        }
+    }
+}
+
+void MidiClockTracker::operator()(MidiMessage& msg) {
+    add(msg);
+}
+
+void MidiClockTracker::tick(int64_t backendTime, int64_t localTime) {
+    if (m_count > 0) {
+        const int64_t previous = m_times[(m_head + Window - 1) % Window];
+        const double gap = static_cast<double>(backendTime - previous);
+
+        if (gap <= 0.0 || (m_current.tickPeriod > 0.0 && gap > ResyncPeriods * m_current.tickPeriod)) {
+            m_count = 0;
+        }
+    }
+
+    m_times[m_head] = backendTime;
+    m_offsets[m_head] = localTime - backendTime;
+    m_head = (m_head + 1) % Window;
+    m_count = std::min(m_count + 1, Window);
+
+    if (m_current.state == MidiTransportState::Playing) {
+        m_current.ticks++;
+    }
+    m_current.lastTick = localTime;
+
+    fit();
+}
+
+// Least squares fit of t = a + b * i over the window, b is the tick period.
+// The last tick's time is read off the fitted line rather than taken from its
+// arrival, and moved to steady_clock by the smallest arrival delay in the
+// window, the one closest to the backend's own timing.
+void MidiClockTracker::fit() {
+    if (m_count < MinimumTicks) {
+        return;
+    }
+
+    const size_t first = (m_head + Window - m_count) % Window;
+    const int64_t origin = m_times[first];
+    const double n = static_cast<double>(m_count);
+
+    double sumY = 0.0, sumXY = 0.0;
+    for (size_t i = 0; i < m_count; i++) {
+        const double y = static_cast<double>(m_times[(first + i) % Window] - origin);
+        sumY += y;
+        sumXY += static_cast<double>(i) * y;
+    }
+
+    const double sumX = n * (n - 1.0) / 2.0;
+    const double sumXX = (n - 1.0) * n * (2.0 * n - 1.0) / 6.0;
+    const double period = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+    const double intercept = (sumY - period * sumX) / n;
+
+    if (period <= 0.0) {
+        return;
+    }
+
+    double residual = 0.0;
+    for (size_t i = 0; i < m_count; i++) {
+        const double y = static_cast<double>(m_times[(first + i) % Window] - origin);
+        const double e = y - (intercept + period * static_cast<double>(i));
+        residual += e * e;
+    }
+
+    int64_t offset = m_offsets[first];
+    for (size_t i = 1; i < m_count; i++) {
+        offset = std::min(offset, m_offsets[(first + i) % Window]);
+    }
+
+    m_current.lastTick = origin + offset + std::llround(intercept + period * (n - 1.0));
+    m_current.tickPeriod = period;
+    m_current.bpm = 60.0e9 / (period * MidiClockState::PPQN);
+    m_current.jitter = std::sqrt(residual / n);
+}
+
+void MidiClockTracker::publish() {
+    const uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_state.store(m_current.state, std::memory_order_relaxed);
+    m_ticks.store(m_current.ticks, std::memory_order_relaxed);
+    m_bpm.store(m_current.bpm, std::memory_order_relaxed);
+    m_tickPeriod.store(m_current.tickPeriod, std::memory_order_relaxed);
+    m_jitter.store(m_current.jitter, std::memory_order_relaxed);
+    m_lastTick.store(m_current.lastTick, std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,123 @@
+#include "Midi/MidiCompressedRecording.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+
+namespace {
+    size_t writeVarint(uint8_t* p, uint64_t value) noexcept {
+        size_t n = 0;
+        while (value >= 0x80) {
+            p[n++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        p[n++] = static_cast<uint8_t>(value);
+        return n;
+    }
+
+    size_t varintLength(uint64_t value) noexcept {
+        size_t n = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            n++;
+        }
+        return n;
+    }
+
+    uint64_t zigzag(int64_t value) noexcept {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+}
+
+
+void MidiCompressedRecording::add(const MidiMessage& msg, int64_t timestamp) {
+    if (msg.size() == 0) {
+        return;
+    }
+
+    const uint8_t status = msg[0];
+    const bool isChannel = status >= 0x80 && status < 0xF0 && msg.size() == dataLength(status) + 1;
+
+    // Worst case size, a new block always starts with an explicit status.
+    size_t needed = 10;
+    if (isChannel) {
+        needed += msg.size();
+    } else {
+        needed += 1 + varintLength(msg.size()) + msg.size();
+    }
+
+    if (needed > Block::Capacity) {
+        spdlog::warn("Compressed recording: dropping {} byte message, larger than a block", msg.size());
+        return;
+    }
+
+    Block& block = blockFor(needed, timestamp);
+    uint8_t* p = block.data.data() + block.header.used;
+    uint8_t* start = p;
+
+    p += writeVarint(p, zigzag(timestamp - block.header.lastTimestamp));
+
+    if (isChannel) {
+        if (status != m_runningStatus) {
+            *p++ = status;
+            m_runningStatus = status;
+        }
+        for (size_t i = 1; i < msg.size(); i++) {
+            *p++ = msg[i];
+        }
+    } else {
+        *p++ = SystemMarker;
+        p += writeVarint(p, msg.size());
+        p = std::copy(msg.begin(), msg.end(), p);
+        m_runningStatus = 0;
+    }
+
+    block.header.used += static_cast<uint32_t>(p - start);
+    block.header.lastTimestamp = timestamp;
+    block.header.count++;
+    m_count++;
+}
+
+void MidiCompressedRecording::clear() {
+    m_blocks.clear();
+    m_count = 0;
+    m_runningStatus = 0;
+}
+
+size_t MidiCompressedRecording::findBlock(int64_t timestamp) const noexcept {
+    auto it = std::partition_point(m_blocks.begin(), m_blocks.end(), [timestamp](const Block& b) {
+        return b.header.lastTimestamp < timestamp;
+    });
+    return static_cast<size_t>(std::distance(m_blocks.begin(), it));
+}
+
+void MidiCompressedRecording::decodeBlock(size_t block, std::vector<MidiMessageRecord>& out) const {
+    out.reserve(out.size() + m_blocks[block].header.count);
+
+    forEachInBlock(block, [&out](const uint8_t* bytes, size_t size, int64_t timestamp) {
+        MidiMessageRecord record;
+        record.message.bytes.assign(bytes, bytes + size);
+        record.timestamp = timestamp;
+        out.push_back(std::move(record));
+    });
+}
+
+std::vector<MidiMessageRecord> MidiCompressedRecording::decode() const {
+    std::vector<MidiMessageRecord> result;
+    result.reserve(m_count);
+
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+        decodeBlock(i, result);
+    }
+
+    return result;
+}
+
+MidiCompressedRecording::Block& MidiCompressedRecording::blockFor(size_t bytesNeeded, int64_t timestamp) {
+    if (m_blocks.empty() || Block::Capacity - m_blocks.back().header.used < bytesNeeded) {
+        Block& block = m_blocks.emplace_back();
+        block.header = BlockHeader{ timestamp, timestamp, 0, 0 };
+        m_runningStatus = 0;
+    }
+
+    return m_blocks.back();
+}
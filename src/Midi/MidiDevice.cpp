@@ -2,88 +2,242 @@
 #include <spdlog/spdlog.h>
 #include <algorithm>
 #include <iostream>
+#include <thread>
 #include <unordered_map>
-#include <regex>
 
 
 
-namespace {
-    std::unordered_map<std::string, int> device_type_count;
+MidiDevice::MidiDevice(libremidi::input_port inPort, libremidi::output_port outPort, size_t captureCapacity,
+                       std::pmr::memory_resource* resource, MidiBackend backend)
+    : m_transport(inPort, outPort, [this](MidiMessage& msg) { 
+        onMidiMessage(msg);
+    }, backend)
+    , m_verifier(m_transport, 2.0, resource)
+    , m_recorder(m_transport, resource)
+    , m_dispatcher(m_transport)
+    , m_statistics(m_transport)
+    , m_clock(m_transport)
+    , m_noteState(m_transport)
+    , m_forwardedNotes(m_transport)
+    , m_highRes(m_transport)
+    , m_captureRing(captureCapacity)
+{
+    open(inPort, outPort);
+}
 
-    std::mutex ns_mutex;
+MidiDevice::~MidiDevice() {
+    close();
 
+    m_verifiedWaiters.cancelAll();
+    m_messageWaiters.cancelAll();
+}
 
-    void AddDeviceCount(std::string name) {
-        std::lock_guard<std::mutex> lock(ns_mutex);
-        
-        if (device_type_count.find(name) == device_type_count.end()) device_type_count[name] = 0;
+void MidiDevice::startRecording() {
+    m_recorder.start();
+}
 
-        device_type_count[name] += 1;
-    }
+void MidiDevice::stopRecording() {
+    m_recorder.stop();
+}
 
-    void RemoveDeviceCount(std::string name) {
-        std::lock_guard<std::mutex> lock(ns_mutex);
+MidiRecordingSnapshot MidiDevice::recorded() const {
+    return m_recorder.recorded();
+}
+
+MidiCompressedRecording MidiDevice::compressedRecorded() const {
+    return m_recorder.compressed();
+}
 
-        name = std::regex_replace(name, std::regex(" \\(\\d\\)+$"), "");
+void MidiDevice::setRecordingMode(RecordingMode mode) {
+    m_recorder.setMode(mode);
+}
 
-        if (device_type_count.find(name) == device_type_count.end()) return;
+RecordingMode MidiDevice::recordingMode() const noexcept {
+    return m_recorder.mode();
+}
 
-        if (device_type_count[name] > 0)
-            device_type_count[name]--;
+void MidiDevice::enableRecordingIndex() {
+    m_recorder.enableIndex();
+}
 
-        if (device_type_count[name] == 0)
-            device_type_count.erase(name);
-    }
+MidiQueryResult MidiDevice::query(const MidiQuery& query) const {
+    return m_recorder.query(query);
+}
+
+std::vector<MidiMessageRecord> MidiDevice::captureLast(std::chrono::milliseconds window) const {
+    return m_captureRing.snapshot(window);
+}
+
+size_t MidiDevice::captureCapacity() const noexcept {
+    return m_captureRing.capacity();
+}
 
+void MidiDevice::enableStatistics(bool enabled) {
+    m_statistics.enable(enabled);
+}
 
-    const std::string GetNameWithCount(std::string name) {
-        if (device_type_count.find(name) == device_type_count.end()) return name;
+void MidiDevice::resetStatistics() {
+    m_statistics.reset();
+}
 
-        return name + " (" + std::to_string(device_type_count.at(name)) + ")";
+MidiStatisticsSnapshot MidiDevice::statistics() const {
+    return m_statistics.snapshot();
+}
+
+MidiClockState MidiDevice::clock() const {
+    return m_clock.state();
+}
+
+void MidiDevice::enableNoteState(bool enabled) {
+    m_noteState.enable(enabled);
+    m_forwardedNotes.enable(enabled);
+}
+
+const MidiNoteState& MidiDevice::noteState() const noexcept {
+    return m_noteState;
+}
+
+void MidiDevice::releaseAllNotes() {
+    m_noteState.releaseAll();
+}
+
+const MidiNoteState& MidiDevice::forwardedNoteState() const noexcept {
+    return m_forwardedNotes;
+}
+
+void MidiDevice::releaseForwardedNotes() {
+    m_forwardedNotes.releaseAll();
+}
+
+void MidiDevice::onHighResEvent(HighResEventCallback cb) {
+    m_highRes.onEvent(cb);
+}
+
+void MidiDevice::setTransform(std::shared_ptr<const MidiTransform> transform) {
+    if (transform && transform->isIdentity()) {
+        transform = nullptr;
     }
-    
-    
-    void ResetDeviceCount() noexcept {
-        device_type_count.clear();
+    m_transform.store(std::move(transform));
+}
+
+std::shared_ptr<const MidiTransform> MidiDevice::transform() const {
+    return m_transform.load();
+}
+
+void MidiDevice::setThru(std::shared_ptr<const MidiThruTable> table) {
+    if (table && table->empty()) {
+        table = nullptr;
     }
+    m_thru.store(std::move(table));
 }
 
+MidiThruStats MidiDevice::thruStats() const noexcept {
+    return m_thruMeter.stats();
+}
 
-MidiDevice::MidiDevice(libremidi::input_port inPort, libremidi::output_port outPort)
-    : m_transport(inPort, outPort, [this](MidiMessage& msg) { 
-        onMidiMessage(msg);
-    })
-    , m_verifier(m_transport)
-    , m_recorder(m_transport)
-    , m_dispatcher(m_transport)
-{
-    open(inPort, outPort);
+void MidiDevice::resetThruStats() noexcept {
+    m_thruMeter.reset();
 }
 
-MidiDevice::~MidiDevice() {
-    close();
+void MidiDevice::setRealtime(int priority) noexcept {
+    m_transport.setRealtime(priority);
 }
 
-void MidiDevice::startRecording() {
-    m_recorder.start();
+std::chrono::steady_clock::time_point MidiDevice::lastActivity() const noexcept {
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(m_lastActivity.load(std::memory_order_relaxed)));
 }
 
-void MidiDevice::stopRecording() {
-    m_recorder.stop();
+bool MidiDevice::sendsActiveSensing() const noexcept {
+    return m_activeSensing;
 }
 
-const std::vector<MidiMessageRecord>& MidiDevice::recorded() const noexcept {
-    return m_recorder.recorded();
+bool MidiDevice::isStalled() const noexcept {
+    return m_stalled;
+}
+
+void MidiDevice::setStalled(bool stalled) noexcept {
+    m_stalled = stalled;
+}
+
+// Identity request, any answer counts as activity
+void MidiDevice::probe() {
+    m_transport.send({0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7});
+}
+
+void MidiDevice::send(const std::vector<unsigned char>& msg) {
+    m_transport.send(msg);
+}
+
+void MidiDevice::send(const unsigned char* data, size_t size) {
+    m_transport.send(data, size);
+}
+
+void MidiDevice::forward(const unsigned char* data, size_t size) {
+    if (m_forwardedNotes.isEnabled()) {
+        m_forwardedNotes.add(data, size);
+    }
+    m_transport.send(data, size);
+}
+
+void MidiDevice::schedule(const std::vector<unsigned char>& msg, MidiOutputScheduler::Clock::time_point when) {
+    m_transport.schedule(msg, when);
+}
+
+void MidiDevice::setOutputBandwidth(size_t bytesPerSecond) {
+    m_transport.setOutputBandwidth(bytesPerSecond);
+}
+
+MidiOutputStats MidiDevice::outputStats() const {
+    return m_transport.outputStats();
+}
+
+void MidiDevice::queue(const std::vector<unsigned char>& msg) {
+    m_transport.queue(msg);
+}
+
+void MidiDevice::flush() {
+    m_transport.flush();
+}
+
+MidiGridFramebuffer* MidiDevice::framebuffer() {
+    std::lock_guard<std::mutex> lock(m_framebufferMutex);
+
+    if (!m_framebuffer && status() == Availability::Available) {
+        auto it = MidiDeviceDB::KNOWN_GRIDS.find(displayName());
+        if (it != MidiDeviceDB::KNOWN_GRIDS.end()) {
+            m_framebuffer = std::make_unique<MidiGridFramebuffer>(m_transport, it->second);
+        }
+    }
+
+    return m_framebuffer.get();
 }
 
 void MidiDevice::onMessage(MidiMessageCallback cb) {
     m_dispatcher.onMessage(cb);
 }
 
+void MidiDevice::onRawMessage(MidiMessageCallback cb) {
+    m_rawCallback.store(cb ? std::make_shared<const MidiMessageCallback>(std::move(cb)) : nullptr);
+}
+
 void MidiDevice::onVerified(VerificationCallback cb) {
     m_verifier.onVerified(cb);
 }
 
+MidiWaitList<Availability>::Awaiter MidiDevice::verified(std::optional<std::chrono::milliseconds> timeout) {
+    return m_verifiedWaiters.wait(nullptr, timeout, [this]() -> std::optional<Availability> {
+        const Availability status = m_verifier.status();
+        if (status == Availability::NotChecked || status == Availability::InProgress) {
+            return std::nullopt;
+        }
+        return status;
+    });
+}
+
+MidiWaitList<MidiMessage>::Awaiter MidiDevice::next(MidiMessageFilter filter, std::optional<std::chrono::milliseconds> timeout) {
+    return m_messageWaiters.wait(std::move(filter), timeout);
+}
+
 void MidiDevice::open(libremidi::input_port inPort, libremidi::output_port outPort) {
     m_transport.open(inPort, outPort);
 
@@ -110,15 +264,75 @@ void MidiDevice::onMidiMessage(MidiMessage& msg) {
     //     m_verifier(msg);
     // }
 
+    TraceSpan span("device.message");
+    const auto arrival = std::chrono::steady_clock::now();
+    m_lastActivity.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        arrival.time_since_epoch()).count(), std::memory_order_relaxed);
+
+    if (msg.size() == 1 && msg[0] == 0xFE) {
+        m_activeSensing.store(true, std::memory_order_relaxed);
+        return;
+    }
+
     if (m_verifier.status() == Availability::InProgress) {
         m_verifier(msg);
+
+        if (m_verifier.status() != Availability::InProgress) {
+            m_verifiedWaiters.notify(m_verifier.status());
+        }
     } 
     else if (m_verifier.status() == Availability::Available) {
-        if (msg.size() == 3) {
+        if (auto raw = m_rawCallback.read()) {
+            (*raw)(msg);
+        }
+
+        m_messageWaiters.notify(msg);
+
+        // Clock is tracked here rather than dispatched tick by tick. Song
+        // position is three bytes but still isn't a channel message.
+        const bool clock = MidiClockTracker::isClockMessage(msg);
+        if (clock) {
+            m_clock(msg);
+        }
+
+        // Sees channel pressure too, which is only two bytes
+        if (m_highRes.isEnabled()) {
+            m_highRes(msg);
+        }
+
+        if (msg.size() == 3 && !clock) {
+            m_captureRing.add(msg);
+
             if (m_recorder.isRecording()) {
+                AllocationScopeExemption exempt;
                 m_recorder.add(msg);
             }
 
+            if (m_statistics.isEnabled()) {
+                m_statistics(msg);
+            }
+
+            if (m_noteState.isEnabled()) {
+                m_noteState(msg);
+            }
+        }
+
+        // Program change and channel pressure are two bytes but have to follow
+        // the same channel map as the notes they go with
+        if (auto transform = m_transform.read()) {
+            transform->apply(msg);
+        }
+
+        // Thru goes out before any user code runs. Sends lock the target's
+        // port, so they are outside the real-time guarantee.
+        if (auto thru = m_thru.read()) {
+            AllocationScopeExemption exempt;
+            if (thru->forward(msg) > 0) {
+                m_thruMeter.record(std::chrono::steady_clock::now() - arrival);
+            }
+        }
+
+        if (msg.size() == 3 && !clock) {
             m_dispatcher(msg);
         }
     }
@@ -133,7 +347,27 @@ std::vector<unsigned char> MidiDevice::identity() const noexcept {
 }
 
 std::string MidiDevice::name() const noexcept {
-    return m_verifier.name();
+    const uint32_t ordinal = m_nameOrdinal.load(std::memory_order_relaxed);
+    if (ordinal == NoOrdinal || ordinal == 0) {
+        return m_verifier.name();
+    }
+    return m_verifier.name() + " (" + std::to_string(ordinal) + ")";
+}
+
+MidiDeviceHandle MidiDevice::handle() const noexcept {
+    return m_handle;
+}
+
+void MidiDevice::setHandle(MidiDeviceHandle handle) noexcept {
+    m_handle = handle;
+}
+
+uint32_t MidiDevice::nameOrdinal() const noexcept {
+    return m_nameOrdinal.load(std::memory_order_relaxed);
+}
+
+void MidiDevice::setNameOrdinal(uint32_t ordinal) noexcept {
+    m_nameOrdinal.store(ordinal, std::memory_order_relaxed);
 }
 
 std::string MidiDevice::displayName() const noexcept {
@@ -151,39 +385,43 @@ const libremidi::output_port& MidiDevice::outPort() const noexcept {
 
 MidiTransport::MidiTransport(libremidi::input_port inPort, 
                              libremidi::output_port outPort, 
-                             MidiMessageCallback cb)
-    : m_midiIn(libremidi::input_configuration{
-        .on_message = [this](MidiMessage msg) { this->handleMidiMessage(msg); },
-        .on_error = std::bind(&MidiTransport::handleErrorMessage, this, std::placeholders::_1, std::placeholders::_2),
-        .on_warning = std::bind(&MidiTransport::handleWarningMessage, this, std::placeholders::_1, std::placeholders::_2),
-        .ignore_sysex = false,
-        .ignore_timing = false,
-        .ignore_sensing = true,
-    })
-    , m_midiOut(libremidi::output_configuration{})
+                             MidiMessageCallback cb,
+                             MidiBackend backend)
+    : m_midiIn(MidiBackends::makeInput(inputConfiguration([this](MidiMessage&& msg) { this->handleMidiMessage(msg); }), backend))
+    , m_midiOut(MidiBackends::makeOutput(libremidi::output_configuration{}, backend))
     , m_userCb(cb)
     , m_inPort(inPort)
     , m_outPort(outPort)
+    , m_ownsInputThread(MidiBackends::ownsInputThread(backend))
 {
+    // Backends that parse the buffer into events (ALSA seq, CoreMIDI) expect
+    // one complete message per send, so running status is opt-in.
+    m_encoder.setRunningStatus(false);
+}
 
+MidiTransport::MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort, MidiBackend backend)
+    : m_midiIn(MidiBackends::makeInput(inputConfiguration([this](MidiMessage&& msg) { this->handleMidiMessage(msg); }), backend))
+    , m_midiOut(MidiBackends::makeOutput(libremidi::output_configuration{}, backend))
+    , m_inPort(inPort)
+    , m_outPort(outPort)
+    , m_ownsInputThread(MidiBackends::ownsInputThread(backend))
+{
+    m_encoder.setRunningStatus(false);
 }
 
-MidiTransport::MidiTransport(libremidi::input_port inPort, libremidi::output_port outPort)
-    : m_midiIn(libremidi::input_configuration{
-        .on_message = [this](MidiMessage msg) { this->handleMidiMessage(msg); },
+libremidi::input_configuration MidiTransport::inputConfiguration(std::function<void(MidiMessage&&)> onMessage) {
+    return libremidi::input_configuration{
+        .on_message = std::move(onMessage),
         .on_error = std::bind(&MidiTransport::handleErrorMessage, this, std::placeholders::_1, std::placeholders::_2),
         .on_warning = std::bind(&MidiTransport::handleWarningMessage, this, std::placeholders::_1, std::placeholders::_2),
         .ignore_sysex = false,
         .ignore_timing = false,
-        .ignore_sensing = true,
-    })
-    , m_midiOut(libremidi::output_configuration{})
-    , m_inPort(inPort)
-    , m_outPort(outPort)
-{
+        .ignore_sensing = false,
+    };
 }
 
 MidiTransport::~MidiTransport() {
+    m_scheduler.reset();
     close();
 }
 
@@ -198,17 +436,106 @@ const libremidi::output_port& MidiTransport::outPort() const noexcept {
 void MidiTransport::open(libremidi::input_port inPort, libremidi::output_port outPort) {
     close();
 
+    // A reopened port may deliver on a new thread
+    m_appliedPriority = 0;
+    m_savedScheduling.reset();
+
     m_midiIn.open_port(inPort);
     m_midiOut.open_port(outPort);
 }
 
 void MidiTransport::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_schedulerMutex);
+        if (m_scheduler) {
+            m_scheduler->clear();
+        }
+    }
+
     m_midiIn.close_port();
     m_midiOut.close_port();
 }
 
+// Once shaping is enabled, plain sends share the port budget as bulk traffic
+// (notes keep realtime priority) instead of bypassing it.
 void MidiTransport::send(const std::vector<unsigned char>& msg) {
-    m_midiOut.send_message(msg);
+    if (m_shaping) {
+        scheduler().schedule(msg, MidiOutputScheduler::Clock::now(), MidiOutputScheduler::classify(msg));
+        return;
+    }
+
+    sendNow(msg.data(), msg.size());
+}
+
+// Used by thru, only a shaped output copies the message
+void MidiTransport::send(const unsigned char* data, size_t size) {
+    if (m_shaping) {
+        std::vector<unsigned char> msg(data, data + size);
+        scheduler().schedule(msg, MidiOutputScheduler::Clock::now(), MidiOutputScheduler::classify(msg));
+        return;
+    }
+
+    sendNow(data, size);
+}
+
+void MidiTransport::schedule(const std::vector<unsigned char>& msg, MidiOutputScheduler::Clock::time_point when) {
+    scheduler().schedule(msg, when, MidiOutputScheduler::classify(msg));
+}
+
+void MidiTransport::schedule(const std::vector<unsigned char>& msg, MidiOutputScheduler::Clock::time_point when, MidiOutputPriority priority) {
+    scheduler().schedule(msg, when, priority);
+}
+
+void MidiTransport::setOutputBandwidth(size_t bytesPerSecond) {
+    scheduler().setBandwidth(bytesPerSecond);
+    m_shaping = bytesPerSecond > 0;
+}
+
+MidiOutputStats MidiTransport::outputStats() const {
+    std::lock_guard<std::mutex> lock(m_schedulerMutex);
+    return m_scheduler ? m_scheduler->stats() : MidiOutputStats{};
+}
+
+void MidiTransport::queue(const std::vector<unsigned char>& msg) {
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    m_encoder.push(msg);
+}
+
+void MidiTransport::flush() {
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    m_encoder.flush([this](const unsigned char* data, size_t size) {
+        if (m_shaping) {
+            scheduler().schedule(std::vector<unsigned char>(data, data + size), 
+                                 MidiOutputScheduler::Clock::now(), MidiOutputPriority::Bulk);
+            return;
+        }
+        sendNow(data, size);
+    });
+}
+
+void MidiTransport::setRunningStatus(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    m_encoder.setRunningStatus(enabled);
+}
+
+MidiEncoderStats MidiTransport::encoderStats() const {
+    std::lock_guard<std::mutex> lock(m_encoderMutex);
+    return m_encoder.stats();
+}
+
+void MidiTransport::sendNow(const unsigned char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_midiOut.send_message(data, size);
+}
+
+MidiOutputScheduler& MidiTransport::scheduler() {
+    std::lock_guard<std::mutex> lock(m_schedulerMutex);
+    if (!m_scheduler) {
+        m_scheduler = std::make_unique<MidiOutputScheduler>([this](const unsigned char* data, size_t size) {
+            sendNow(data, size);
+        });
+    }
+    return *m_scheduler;
 }
 
 void MidiTransport::onMidiMessage(MidiMessageCallback cb) {
@@ -219,13 +546,57 @@ void MidiTransport::operator()(MidiMessage& msg) {
     m_userCb(msg);
 }
 
+void MidiTransport::setRealtime(int priority) noexcept {
+    m_realtimePriority.store(std::max(priority, 0), std::memory_order_relaxed);
+}
+
+// Tried once per request, a refusal is reported but not retried per message.
+// The thread's own scheduling is saved before the first change and restored
+// exactly when real-time mode ends.
+void MidiTransport::applyRealtime(int priority) noexcept {
+    m_appliedPriority = priority;
+
+    if (!m_ownsInputThread) {
+        if (priority > 0) {
+            MidiDeferredLog::instance().post(MidiDeferredLog::Level::Warning,
+                                             "Realtime: the backend owns the input thread, its priority is left alone");
+        }
+        return;
+    }
+
+    if (priority == 0) {
+        if (m_savedScheduling) {
+            MidiRealtime::setCurrentThreadScheduling(*m_savedScheduling);
+            m_savedScheduling.reset();
+        }
+        return;
+    }
+
+    if (!m_savedScheduling) {
+        m_savedScheduling = MidiRealtime::currentThreadScheduling();
+    }
+    if (!MidiRealtime::setCurrentThreadPriority(priority)) {
+        MidiDeferredLog::instance().post(MidiDeferredLog::Level::Warning,
+                                         "Realtime: input thread priority not permitted, keeping the normal policy");
+    }
+}
+
 void MidiTransport::handleMidiMessage(MidiMessage& msg) {
+    AllocationScope scope;
+    TraceSpan span("transport.input");
+    checkRealtime();
+
     if (m_userCb) {
         m_userCb(msg);
     }
 }
 
 void MidiTransport::handleErrorMessage(std::string_view info, const std::source_location& source) {
+    if (m_realtimePriority.load(std::memory_order_relaxed) > 0) {
+        MidiDeferredLog::instance().post(MidiDeferredLog::Level::Error, info, source);
+        return;
+    }
+
     spdlog::error("(File({}) | Ln({})) Midi Error: {}", source.file_name(), source.line(), info);
     if (m_errorCb) {
         m_errorCb(info, source);
@@ -233,6 +604,11 @@ void MidiTransport::handleErrorMessage(std::string_view info, const std::source_
 }
 
 void MidiTransport::handleWarningMessage(std::string_view info, const std::source_location& source) {
+    if (m_realtimePriority.load(std::memory_order_relaxed) > 0) {
+        MidiDeferredLog::instance().post(MidiDeferredLog::Level::Warning, info, source);
+        return;
+    }
+
     spdlog::warn("(File({}) | Ln({})) Midi Error: {}", source.file_name(), source.line(), info);
     if (m_warningCb) {
         m_warningCb(info, source);
@@ -240,17 +616,15 @@ void MidiTransport::handleWarningMessage(std::string_view info, const std::sourc
 }
 
 
-MidiIdentityVerifier::MidiIdentityVerifier(MidiTransport& transport, double timeout) 
+MidiIdentityVerifier::MidiIdentityVerifier(MidiTransport& transport, double timeout, std::pmr::memory_resource* resource) 
     : m_transport(transport)
+    , m_identity(resource)
     , m_timeout(timeout)
 {
 }
 
-MidiIdentityVerifier::~MidiIdentityVerifier() {
-    RemoveDeviceCount(m_deviceName);
-}
-
 void MidiIdentityVerifier::verify() {
+    TraceSpan span("verifier.verify");
     m_transport.send({0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7});
     
     m_status = Availability::InProgress;
@@ -266,7 +640,7 @@ Availability MidiIdentityVerifier::status() const noexcept {
 }
 
 std::vector<unsigned char> MidiIdentityVerifier::identity() const noexcept {
-    return m_identity;
+    return std::vector<unsigned char>(m_identity.begin(), m_identity.end());
 }
 
 std::string MidiIdentityVerifier::name() const noexcept {
@@ -278,6 +652,7 @@ std::string MidiIdentityVerifier::displayName() const noexcept {
 }
 
 void MidiIdentityVerifier::operator()(MidiMessage& msg) {
+    TraceSpan span("verifier.reply");
     if (m_status == Availability::InProgress) {
         auto now = std::chrono::steady_clock::now();
         if (std::chrono::duration_cast<std::chrono::seconds>(now - m_verifyStart).count() > m_timeout) {
@@ -335,11 +710,9 @@ void MidiIdentityVerifier::operator()(MidiMessage& msg) {
             std::lock_guard<std::mutex> lock(m_mutex);
             m_status = Availability::Available;
             m_displayName = deviceName;
+            m_deviceName = deviceName;
 
-            m_deviceName = GetNameWithCount(deviceName);
-            AddDeviceCount(deviceName);
-
-            m_identity = std::vector<unsigned char>(payloadBegin, payloadEnd);
+            m_identity.assign(payloadBegin, payloadEnd);
 
             break;
         } else {
@@ -356,13 +729,21 @@ void MidiIdentityVerifier::operator()(MidiMessage& msg) {
 }
 
 
-MidiRecorder::MidiRecorder(MidiTransport& transport) 
+MidiRecorder::MidiRecorder(MidiTransport& transport, std::pmr::memory_resource* resource) 
     : m_transport(transport) 
+    , m_recorded(resource)
+    , m_compressed(resource)
 {}
 
+// The index and the time queries rely on timestamps never decreasing, so the
+// time base is only set by the first start after construction or clear()
 void MidiRecorder::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_started) {
+        m_start = std::chrono::steady_clock::now();
+        m_started = true;
+    }
     m_recording = true;
-    m_start = std::chrono::steady_clock::now();
 }
 
 void MidiRecorder::stop() {
@@ -371,21 +752,114 @@ void MidiRecorder::stop() {
 
 void MidiRecorder::add(const MidiMessage& msg) {
     std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = std::chrono::steady_clock::now();
+    int64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_start).count();
+
+    if (m_mode == RecordingMode::Compressed) {
+        m_compressed.add(msg, timestamp);
+        return;
+    }
+
     MidiMessageRecord record;
     record.message = msg;
-    auto now = std::chrono::steady_clock::now();
-    record.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_start).count();
+    record.timestamp = timestamp;
+
+    if (auto index = m_index.load(std::memory_order_relaxed)) {
+        index->add(record);
+    }
 
-    m_recorded.push_back(record);
+    m_recorded.push_back(std::move(record));
 }
 
 void MidiRecorder::clear() {
     std::lock_guard<std::mutex> lock(m_mutex);
+    m_generation.fetch_add(1);
+
     m_recorded.clear();
+    m_compressed.clear();
+
+    if (auto index = m_index.load(std::memory_order_relaxed)) {
+        index->clear();
+    }
+
+    // A running recording continues on a fresh time base
+    m_started = m_recording;
+    m_start = std::chrono::steady_clock::now();
+
+    m_generation.fetch_add(1);
+}
+
+// Full mode hands out a view of the log without copying or locking. A compressed
+// capture has to be decoded, which briefly holds off the writer.
+MidiRecordingSnapshot MidiRecorder::recorded() const {
+    if (m_mode == RecordingMode::Compressed) {
+        AppendLog<MidiMessageRecord> decoded(m_recorded.resource());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_compressed.blockCount(); i++) {
+                m_compressed.forEachInBlock(i, [&decoded](const uint8_t* bytes, size_t size, int64_t timestamp) {
+                    MidiMessageRecord record;
+                    record.message.bytes.assign(bytes, bytes + size);
+                    record.timestamp = timestamp;
+                    decoded.push_back(std::move(record));
+                });
+            }
+        }
+        return decoded.snapshot();
+    }
+
+    return m_recorded.snapshot();
+}
+
+MidiCompressedRecording MidiRecorder::compressed() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_compressed;
 }
 
-const std::vector<MidiMessageRecord>& MidiRecorder::recorded() const noexcept {
-    return m_recorded;
+// Indexes whatever was already recorded, then keeps up with new records.
+// Only full mode recordings are indexed.
+void MidiRecorder::enableIndex() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_indexStorage) {
+        return;
+    }
+
+    const auto resource = m_recorded.resource();
+    m_indexStorage = std::allocate_shared<MidiRecordingIndex>(
+        std::pmr::polymorphic_allocator<MidiRecordingIndex>(resource), resource);
+    for (const auto& record : m_recorded.snapshot()) {
+        m_indexStorage->add(record);
+    }
+
+    m_index.store(m_indexStorage.get(), std::memory_order_release);
+}
+
+MidiQueryResult MidiRecorder::query(const MidiQuery& query) const {
+    auto index = m_index.load(std::memory_order_acquire);
+    if (!index) {
+        spdlog::warn("Recording query without an index, call enableIndex() first");
+        return {};
+    }
+
+    // Postings and records have to come from the same log, retry if a clear()
+    // ran in between
+    for (;;) {
+        const uint64_t generation = m_generation.load();
+        if (generation & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        MidiQueryResult result = index->query(query, m_recorded);
+        if (m_generation.load() == generation) {
+            return result;
+        }
+    }
+}
+
+void MidiRecorder::setMode(RecordingMode mode) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_mode = mode;
 }
 
 
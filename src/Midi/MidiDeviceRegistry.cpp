@@ -0,0 +1,84 @@
+#include "Midi/MidiDeviceRegistry.h"
+#include <algorithm>
+
+
+MidiDeviceHandle MidiDeviceRegistry::add(std::shared_ptr<MidiDevice> device) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t index;
+    if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+    }
+
+    Slot& slot = m_slots[index];
+    slot.device = std::move(device);
+    return { index, slot.generation };
+}
+
+void MidiDeviceRegistry::remove(MidiDeviceHandle handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation) {
+        return;
+    }
+
+    Slot& slot = m_slots[handle.index];
+    slot.device.reset();
+    slot.generation++;
+    m_free.push_back(handle.index);
+}
+
+std::shared_ptr<MidiDevice> MidiDeviceRegistry::get(MidiDeviceHandle handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation) {
+        return nullptr;
+    }
+    return m_slots[handle.index].device;
+}
+
+bool MidiDeviceRegistry::contains(MidiDeviceHandle handle) const {
+    return get(handle) != nullptr;
+}
+
+size_t MidiDeviceRegistry::slotCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slots.size();
+}
+
+uint32_t MidiDeviceRegistry::acquireOrdinal(std::string_view displayName) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& used = m_ordinals[std::string(displayName)];
+    auto it = std::find(used.begin(), used.end(), false);
+    const auto ordinal = static_cast<uint32_t>(it - used.begin());
+
+    if (it == used.end()) {
+        used.push_back(true);
+    } else {
+        *it = true;
+    }
+    return ordinal;
+}
+
+void MidiDeviceRegistry::releaseOrdinal(std::string_view displayName, uint32_t ordinal) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_ordinals.find(std::string(displayName));
+    if (it == m_ordinals.end() || ordinal >= it->second.size()) {
+        return;
+    }
+
+    auto& used = it->second;
+    used[ordinal] = false;
+    while (!used.empty() && !used.back()) {
+        used.pop_back();
+    }
+    if (used.empty()) {
+        m_ordinals.erase(it);
+    }
+}
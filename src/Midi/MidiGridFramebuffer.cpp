@@ -0,0 +1,121 @@
+#include "Midi/MidiGridFramebuffer.h"
+#include "Midi/MidiDevice.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIDI_GRID_SSE2 1
+#endif
+
+
+MidiGridFramebuffer::MidiGridFramebuffer(MidiTransport& transport, GridLayout layout)
+    : m_transport(transport)
+    , m_layout(std::move(layout))
+    , m_cells(std::min(m_layout.rows * m_layout.cols, MaxCells))
+{
+}
+
+void MidiGridFramebuffer::set(size_t row, size_t col, uint8_t colour) noexcept {
+    if (row >= m_layout.rows || col >= m_layout.cols) {
+        return;
+    }
+    m_back[row * m_layout.cols + col] = colour & 0x7F;
+}
+
+void MidiGridFramebuffer::fill(uint8_t colour) noexcept {
+    std::fill(m_back.begin(), m_back.begin() + m_cells, static_cast<uint8_t>(colour & 0x7F));
+}
+
+size_t MidiGridFramebuffer::present() {
+    return present(m_back);
+}
+
+size_t MidiGridFramebuffer::present(const Frame& frame) {
+    std::array<uint8_t, MaxCells> changed;
+    const size_t count = diff(frame, changed);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    const size_t perMessage = std::max<size_t>(m_layout.maxLedsPerMessage, 1);
+    std::vector<unsigned char> msg;
+    msg.reserve(m_layout.sysexHeader.size() + 2 + 2 * std::min(count, perMessage));
+
+    for (size_t i = 0; i < count; i += perMessage) {
+        msg.assign(m_layout.sysexHeader.begin(), m_layout.sysexHeader.end());
+        msg.push_back(m_layout.ledCommand);
+
+        for (size_t j = i; j < std::min(count, i + perMessage); j++) {
+            const size_t cell = changed[j];
+            msg.push_back(padFor(cell));
+            msg.push_back(frame[cell] & 0x7F);
+        }
+
+        msg.push_back(0xF7);
+        m_transport.send(msg);
+    }
+
+    std::copy(frame.begin(), frame.begin() + m_cells, m_front.begin());
+    m_valid = true;
+
+    return count;
+}
+
+void MidiGridFramebuffer::invalidate() noexcept {
+    m_valid = false;
+}
+
+// Collects the indices of cells that differ from the last frame sent
+size_t MidiGridFramebuffer::diff(const Frame& frame, std::array<uint8_t, MaxCells>& changed) const noexcept {
+    size_t count = 0;
+
+    if (!m_valid) {
+        for (size_t i = 0; i < m_cells; i++) {
+            changed[count++] = static_cast<uint8_t>(i);
+        }
+        return count;
+    }
+
+#ifdef MIDI_GRID_SSE2
+    for (size_t base = 0; base < m_cells; base += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame.data() + base));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_front.data() + base));
+        uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) & 0xFFFF;
+
+        while (mask) {
+            const size_t cell = base + std::countr_zero(mask);
+            mask &= mask - 1;
+            if (cell < m_cells) {
+                changed[count++] = static_cast<uint8_t>(cell);
+            }
+        }
+    }
+#else
+    for (size_t base = 0; base < m_cells; base += 8) {
+        uint64_t a, b;
+        std::memcpy(&a, frame.data() + base, sizeof(a));
+        std::memcpy(&b, m_front.data() + base, sizeof(b));
+        uint64_t delta = a ^ b;
+
+        while (delta) {
+            const size_t cell = base + std::countr_zero(delta) / 8;
+            delta &= ~(uint64_t{0xFF} << ((cell - base) * 8));
+            if (cell < m_cells) {
+                changed[count++] = static_cast<uint8_t>(cell);
+            }
+        }
+    }
+#endif
+
+    return count;
+}
+
+unsigned char MidiGridFramebuffer::padFor(size_t cell) const noexcept {
+    const size_t row = cell / m_layout.cols;
+    const size_t col = cell % m_layout.cols;
+    const size_t fromBottom = m_layout.rows - 1 - row;
+    return static_cast<unsigned char>(m_layout.firstPad + fromBottom * m_layout.rowStride + col);
+}
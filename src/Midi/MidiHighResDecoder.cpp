@@ -0,0 +1,187 @@
+#include "Midi/MidiHighResDecoder.h"
+#include "Midi/MidiDevice.h"
+#include <algorithm>
+
+
+namespace {
+    constexpr uint16_t scale7(uint8_t value) noexcept {
+        return static_cast<uint16_t>((value << 7) | value);
+    }
+}
+
+
+MidiHighResDecoder::MidiHighResDecoder(MidiTransport& transport)
+    : m_transport(transport)
+{}
+
+void MidiHighResDecoder::onEvent(HighResEventCallback cb) {
+    m_callback.store(cb ? std::make_shared<const HighResEventCallback>(std::move(cb)) : nullptr);
+}
+
+void MidiHighResDecoder::add(const MidiMessage& msg) {
+    if (msg.size() < 2 || msg[0] < 0x80 || msg[0] >= 0xF0) {
+        return;
+    }
+
+    const uint8_t channel = msg[0] & 0x0F;
+    const uint8_t type = msg[0] & 0xF0;
+    const uint8_t data1 = msg[1] & 0x7F;
+    const uint8_t data2 = msg.size() > 2 ? msg[2] & 0x7F : 0;
+    ChannelState& state = m_channels[channel];
+
+    if (type == 0xB0 && msg.size() > 2) {
+        controlChange(channel, data1, data2);
+        return;
+    }
+
+    switch (type) {
+        case 0x90:
+            if (data2 != 0) {
+                state.note = static_cast<int8_t>(data1);
+            } else if (state.note == data1) {
+                state.note = MidiHighResEvent::NoNote;
+            }
+            break;
+        case 0x80:
+            if (state.note == data1) {
+                state.note = MidiHighResEvent::NoNote;
+            }
+            break;
+        case 0xE0:
+            if (msg.size() > 2) {
+                emit(MidiHighResType::PitchBend, channel, 0, static_cast<uint16_t>(data1 | (data2 << 7)));
+            }
+            break;
+        case 0xD0:
+            if (isMemberChannel(channel)) {
+                emit(MidiHighResType::Pressure, channel, 0, scale7(data1));
+            }
+            break;
+    }
+}
+
+void MidiHighResDecoder::reset() noexcept {
+    m_channels = {};
+    m_lowerZone = 0;
+    m_upperZone = 0;
+}
+
+void MidiHighResDecoder::operator()(MidiMessage& msg) {
+    add(msg);
+}
+
+void MidiHighResDecoder::controlChange(uint8_t channel, uint8_t number, uint8_t value) {
+    ChannelState& state = m_channels[channel];
+    const bool parameterSelected = state.parameterMsb != NullParameter || state.parameterLsb != NullParameter;
+
+    // Controller MSB, a coarse value until its LSB refines it
+    if (number < 32 && number != 6) {
+        state.msb[number] = value;
+        emit(MidiHighResType::ControlChange, channel, number, static_cast<uint16_t>(value << 7));
+        return;
+    }
+
+    // Controller LSB, completes the pair
+    if (number >= 32 && number < 64 && number != 38) {
+        const uint8_t controller = number - 32;
+        emit(MidiHighResType::ControlChange, channel, controller,
+             static_cast<uint16_t>((state.msb[controller] << 7) | value), true);
+        return;
+    }
+
+    switch (number) {
+        case 99:
+            state.parameterMsb = value;
+            state.registered = false;
+            break;
+        case 98:
+            state.parameterLsb = value;
+            state.registered = false;
+            break;
+        case 101:
+            state.parameterMsb = value;
+            state.registered = true;
+            break;
+        case 100:
+            state.parameterLsb = value;
+            state.registered = true;
+            break;
+        case 6:
+            if (parameterSelected) {
+                state.data = static_cast<uint16_t>(value << 7);
+                dataEntry(channel);
+            }
+            break;
+        case 38:
+            if (parameterSelected) {
+                state.data = static_cast<uint16_t>((state.data & 0x3F80) | value);
+                dataEntry(channel, true);
+            }
+            break;
+        case 96:
+            if (parameterSelected && state.data < 0x3FFF) {
+                state.data++;
+                dataEntry(channel);
+            }
+            break;
+        case 97:
+            if (parameterSelected && state.data > 0) {
+                state.data--;
+                dataEntry(channel);
+            }
+            break;
+        case 74:
+            if (isMemberChannel(channel)) {
+                emit(MidiHighResType::Timbre, channel, number, scale7(value));
+            }
+            break;
+    }
+}
+
+void MidiHighResDecoder::dataEntry(uint8_t channel, bool refinement) {
+    const ChannelState& state = m_channels[channel];
+    const uint16_t parameter = static_cast<uint16_t>((state.parameterMsb << 7) | state.parameterLsb);
+
+    // RPN 6 is the MPE Configuration Message, the data MSB is the member count
+    if (state.registered && parameter == 6 && !refinement) {
+        configureZone(channel, static_cast<uint8_t>(state.data >> 7));
+    }
+
+    emit(state.registered ? MidiHighResType::RPN : MidiHighResType::NRPN, channel, parameter, state.data, refinement);
+}
+
+void MidiHighResDecoder::configureZone(uint8_t channel, uint8_t members) {
+    members = std::min<uint8_t>(members, 15);
+
+    // A zone that grows into the other one shrinks it
+    if (channel == 0) {
+        m_lowerZone = members;
+        m_upperZone = std::min<uint8_t>(m_upperZone, static_cast<uint8_t>(members >= 14 ? 0 : 14 - members));
+    } else if (channel == 15) {
+        m_upperZone = members;
+        m_lowerZone = std::min<uint8_t>(m_lowerZone, static_cast<uint8_t>(members >= 14 ? 0 : 14 - members));
+    }
+}
+
+bool MidiHighResDecoder::isMemberChannel(uint8_t channel) const noexcept {
+    return (channel >= 1 && channel <= m_lowerZone) ||
+           (channel <= 14 && m_upperZone > 0 && channel >= 15 - m_upperZone);
+}
+
+void MidiHighResDecoder::emit(MidiHighResType type, uint8_t channel, uint16_t number, uint16_t value, bool refinement) {
+    auto callback = m_callback.read();
+    if (!callback) {
+        return;
+    }
+
+    MidiHighResEvent event;
+    event.type = type;
+    event.channel = channel;
+    event.number = number;
+    event.value = value;
+    event.refinement = refinement;
+    if (isMemberChannel(channel)) {
+        event.note = m_channels[channel].note;
+    }
+    (*callback)(event);
+}
@@ -3,36 +3,51 @@
 #include <algorithm>
 #include <regex>
 #include <iostream>
+#include <thread>
 
-MidiPortManager::MidiPortManager()
-    : m_portsChanged(nullptr)
+namespace {
+    MidiBackend usableBackend(MidiBackend backend) {
+        if (!MidiBackends::isAvailable(backend)) {
+            spdlog::warn("MIDI backend {} is not available, using the default", MidiBackends::name(backend));
+            return MidiBackend::Default;
+        }
+        return backend;
+    }
+}
+
+MidiPortManager::MidiPortManager(MidiBackend backend, std::pmr::memory_resource* resource)
+    : m_inPorts(resource)
+    , m_outPorts(resource)
+    , m_portsChanged(nullptr)
     , m_inputAdded(nullptr)
     , m_inputRemoved(nullptr)
     , m_outputAdded(nullptr)
     , m_outputRemoved(nullptr)
-    , m_observer(libremidi::observer_configuration{
+    , m_observer(MidiBackends::makeObserver(libremidi::observer_configuration{
         .on_error = std::bind(&MidiPortManager::ErrorMessage, this, std::placeholders::_1, std::placeholders::_2),
         .on_warning = std::bind(&MidiPortManager::WarningMessage, this, std::placeholders::_1, std::placeholders::_2),
         .input_added = std::bind(&MidiPortManager::InputAdded, this, std::placeholders::_1),
         .input_removed = std::bind(&MidiPortManager::InputRemoved, this, std::placeholders::_1),
         .output_added = std::bind(&MidiPortManager::OutputAdded, this, std::placeholders::_1),
         .output_removed = std::bind(&MidiPortManager::OutputRemoved, this, std::placeholders::_1),
-    })
+    }, backend))
 {
 }
 
 void MidiPortManager::scan() {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_inPorts = m_observer.get_input_ports();
-    m_outPorts = m_observer.get_output_ports();
+    auto inPorts = m_observer.get_input_ports();
+    auto outPorts = m_observer.get_output_ports();
+    m_inPorts.assign(inPorts.begin(), inPorts.end());
+    m_outPorts.assign(outPorts.begin(), outPorts.end());
 }
 
 std::vector<libremidi::input_port> MidiPortManager::inputs() const noexcept {
-    return m_inPorts;
+    return std::vector<libremidi::input_port>(m_inPorts.begin(), m_inPorts.end());
 }
 
 std::vector<libremidi::output_port> MidiPortManager::outputs() const noexcept {
-    return m_outPorts;
+    return std::vector<libremidi::output_port>(m_outPorts.begin(), m_outPorts.end());
 }
 
 void MidiPortManager::onPortsChanged(std::function<void()> cb) {
@@ -170,31 +185,29 @@ void MidiPortManager::OutputRemoved(const libremidi::output_port &val) {
 
 
 
-MidiDeviceManager::MidiDeviceManager()
-    : m_recording(false)
+MidiDeviceManager::MidiDeviceManager(std::pmr::memory_resource* resource)
+    : MidiDeviceManager(MidiBackend::Default, resource)
+{
+}
+
+MidiDeviceManager::MidiDeviceManager(MidiBackend backend, std::pmr::memory_resource* resource)
+    : m_resource(resource)
+    , m_backend(usableBackend(backend))
+    , m_devices(resource)
+    , m_recording(false)
     , m_deviceRefreshDebouncer(std::chrono::milliseconds(300), 
         [this](std::vector<MidiDevice*> devices) {
             if (m_devicesRefreshCallback) {
                 m_devicesRefreshCallback(devices);
             }
         })
-    , m_deviceAddedDebouncer(std::chrono::milliseconds(300), 
-        [this](MidiDevice* device) {
-            if (m_deviceAddedCallback) {
-                m_deviceAddedCallback(device);
-            }
-        })
-    , m_deviceRemovedDebouncer(std::chrono::milliseconds(300), 
-        [this](MidiDevice* device) {
-            if (m_deviceRemovedCallback) {
-                m_deviceRemovedCallback(device);
-            }
-        })
-    , m_handlePortRefreshDebouncer(std::chrono::milliseconds(300), 
+    , m_handlePortRefreshDebouncer(std::chrono::milliseconds(100), 
         [this]() 
         { 
             this->handlePortRefresh(); 
-        })
+        },
+        DebounceOptions{ .leading = true, .trailing = true, .maxWait = std::chrono::milliseconds(500) })
+    , m_portManager(m_backend, resource)
 {
     m_portManager.onPortsChanged([this]() { m_handlePortRefreshDebouncer.trigger(); }); //std::bind(&MidiDeviceManager::handlePortRefresh, this)
     m_portManager.onInputAdded([this](const libremidi::input_port &val) { });
@@ -214,33 +227,208 @@ MidiDeviceManager::MidiDeviceManager()
     m_handlePortRefreshDebouncer.trigger();
 }
 
+MidiDeviceManager::~MidiDeviceManager() {
+    // The timer thread outlives the manager, cancel() waits for a running check
+    disableLiveness();
+    disableRealtime();
+}
+
+std::pmr::memory_resource* MidiDeviceManager::resource() const noexcept {
+    return m_resource;
+}
+
+MidiBackend MidiDeviceManager::backend() const noexcept {
+    return m_backend;
+}
+
 void MidiDeviceManager::startRecording() {
-    m_recording = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_recording = true;
+    }
     for (auto d : this->getAvailableDevices()) {
         d->startRecording();
     }
 }
 
 void MidiDeviceManager::stopRecording() {
-    m_recording = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_recording = false;
+    }
     for (auto d : this->getAvailableDevices()) {
         d->stopRecording();
     }
 }
 
-std::vector<std::pair<std::string, std::vector<MidiMessageRecord>>> MidiDeviceManager::recorded() {
+std::vector<std::pair<std::string, MidiRecordingSnapshot>> MidiDeviceManager::recorded() {
+    std::vector<std::pair<std::string, MidiRecordingSnapshot>> result;
+
+    for (auto d : this->getAvailableDevices()) {
+        auto snapshot = d->recorded();
+        if (snapshot.empty()) {
+            continue;
+        }
+        result.push_back(std::make_pair(d->name(), std::move(snapshot)));
+    }
+
+    return result;
+}
+
+void MidiDeviceManager::setRecordingMode(RecordingMode mode) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_recordingMode = mode;
+    }
+    for (auto d : this->getDevices()) {
+        d->setRecordingMode(mode);
+    }
+}
+
+void MidiDeviceManager::enableRecordingIndex() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_recordingIndexed = true;
+    }
+    for (auto d : this->getDevices()) {
+        d->enableRecordingIndex();
+    }
+}
+
+std::vector<std::pair<std::string, std::vector<MidiMessageRecord>>> MidiDeviceManager::captureLast(std::chrono::milliseconds window) {
     std::vector<std::pair<std::string, std::vector<MidiMessageRecord>>> result;
 
     for (auto d : this->getAvailableDevices()) {
-        if (d->recorded().empty()) {
+        auto captured = d->captureLast(window);
+        if (captured.empty()) {
             continue;
         }
-        result.push_back(std::make_pair(d->name(), d->recorded()));
+        result.push_back(std::make_pair(d->name(), std::move(captured)));
+    }
+
+    return result;
+}
+
+void MidiDeviceManager::enableStatistics(bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statisticsEnabled = enabled;
+    }
+    for (auto d : this->getDevices()) {
+        d->enableStatistics(enabled);
+    }
+}
+
+std::vector<std::pair<std::string, MidiStatisticsSnapshot>> MidiDeviceManager::statistics() {
+    std::vector<std::pair<std::string, MidiStatisticsSnapshot>> result;
+
+    for (auto d : this->getAvailableDevices()) {
+        result.push_back(std::make_pair(d->name(), d->statistics()));
+    }
+
+    return result;
+}
+
+void MidiDeviceManager::enableNoteState(bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_noteStateEnabled = enabled;
+    }
+    for (auto d : this->getDevices()) {
+        d->enableNoteState(enabled);
     }
+}
+
+void MidiDeviceManager::setTransform(std::shared_ptr<const MidiTransform> transform) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_transform = transform;
+    }
+    for (auto d : this->getDevices()) {
+        d->setTransform(transform);
+    }
+}
+
+uint32_t MidiDeviceManager::addRoute(const MidiRoute& route) {
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_routesMutex);
+        id = m_nextRouteId++;
+        m_routes.emplace_back(id, route);
+    }
+    resolveRoutes();
+    return id;
+}
+
+void MidiDeviceManager::removeRoute(uint32_t id) {
+    {
+        std::lock_guard<std::mutex> lock(m_routesMutex);
+        std::erase_if(m_routes, [id](const auto& entry) { return entry.first == id; });
+    }
+    resolveRoutes();
+}
+
+void MidiDeviceManager::clearRoutes() {
+    {
+        std::lock_guard<std::mutex> lock(m_routesMutex);
+        m_routes.clear();
+    }
+    resolveRoutes();
+}
 
+std::vector<MidiRoute> MidiDeviceManager::routes() {
+    std::lock_guard<std::mutex> lock(m_routesMutex);
+    std::vector<MidiRoute> result;
+    result.reserve(m_routes.size());
+    for (const auto& [id, route] : m_routes) {
+        result.push_back(route);
+    }
     return result;
 }
 
+std::vector<std::pair<std::string, MidiThruStats>> MidiDeviceManager::thruStats() {
+    std::vector<std::pair<std::string, MidiThruStats>> result;
+    for (auto d : this->getDevices()) {
+        result.emplace_back(d->name(), d->thruStats());
+    }
+    return result;
+}
+
+// Builds each source's table from the routes and publishes it. Routes whose
+// devices are gone are dropped here.
+void MidiDeviceManager::resolveRoutes() {
+    std::vector<std::shared_ptr<MidiDevice>> devices;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        devices.assign(m_devices.begin(), m_devices.end());
+    }
+
+    std::lock_guard<std::mutex> lock(m_routesMutex);
+
+    std::erase_if(m_routes, [this](const auto& entry) {
+        return !m_registry.contains(entry.second.from) || !m_registry.contains(entry.second.to);
+    });
+
+    for (auto& source : devices) {
+        std::vector<MidiThruTable::Target> targets;
+        for (const auto& [id, route] : m_routes) {
+            if (route.from != source->handle()) {
+                continue;
+            }
+            if (auto target = m_registry.get(route.to)) {
+                targets.push_back({ std::move(target), route.channels, route.types, route.channel });
+            }
+        }
+
+        source->setThru(targets.empty() ? nullptr : std::make_shared<const MidiThruTable>(std::move(targets)));
+    }
+}
+
+// Only applies to devices created by the next port refresh
+void MidiDeviceManager::setCaptureCapacity(size_t capacity) {
+    m_captureCapacity.store(capacity, std::memory_order_relaxed);
+}
+
 void MidiDeviceManager::onError(ErrorCallback cb) {
     m_errorCallback = cb;
 }
@@ -265,7 +453,150 @@ void MidiDeviceManager::onDeviceRemoved(DeviceRemovedCallback cb) {
     m_deviceRemovedCallback = cb;
 }
 
+void MidiDeviceManager::onDeviceStalled(DeviceStalledCallback cb) {
+    m_deviceStalledCallback = cb;
+}
+
+// Devices only decode while a callback is set
+void MidiDeviceManager::onHighResEvent(DeviceHighResEventCallback cb) {
+    m_highResCallback = cb;
+    for (auto d : this->getDevices()) {
+        if (cb) {
+            d->onHighResEvent([this, d](const MidiHighResEvent &e) { m_highResCallback(d, e); });
+        } else {
+            d->onHighResEvent(nullptr);
+        }
+    }
+}
+
+MidiWaitList<MidiDevice*>::Awaiter MidiDeviceManager::deviceAdded(std::optional<std::chrono::milliseconds> timeout) {
+    return m_deviceAddedWaiters.wait(nullptr, timeout);
+}
+
+void MidiDeviceManager::enableLiveness(std::chrono::milliseconds probeInterval, std::chrono::milliseconds timeout) {
+    disableLiveness();
+
+    // Checking at half the shorter interval bounds detection to timeout + interval / 2
+    auto period = std::max(std::min(probeInterval, timeout) / 2, std::chrono::milliseconds(1));
+    m_livenessTimer = m_timers.every(period, [this, probeInterval, timeout]() { 
+        checkLiveness(probeInterval, timeout); 
+    });
+}
+
+void MidiDeviceManager::disableLiveness() {
+    if (m_livenessTimer != 0) {
+        m_timers.cancel(m_livenessTimer);
+        m_livenessTimer = 0;
+    }
+}
+
+bool MidiDeviceManager::enableRealtime(int priority) {
+    disableRealtime();
+
+    const bool locked = MidiRealtime::lockMemory();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_realtimePriority = std::max(priority, 1);
+    }
+    for (auto d : this->getDevices()) {
+        d->setRealtime(std::max(priority, 1));
+    }
+
+    m_realtimeTimer = m_timers.every(std::chrono::milliseconds(50), [this]() {
+        reportDeferred();
+    });
+    return locked;
+}
+
+void MidiDeviceManager::disableRealtime() {
+    if (m_realtimeTimer == 0) {
+        return;
+    }
+
+    m_timers.cancel(m_realtimeTimer);
+    m_realtimeTimer = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_realtimePriority = 0;
+    }
+    for (auto d : this->getDevices()) {
+        d->setRealtime(0);
+    }
+
+    reportDeferred();
+    MidiRealtime::unlockMemory();
+}
+
+void MidiDeviceManager::reportDeferred() {
+    MidiDeferredLog::instance().drain([this](const MidiDeferredLog::Entry &entry) {
+        const auto& source = entry.location;
+        if (entry.level == MidiDeferredLog::Level::Error) {
+            spdlog::error("(File({}) | Ln({})) Midi Error: {}", source.file_name(), source.line(), entry.message());
+            if (m_errorCallback) {
+                m_errorCallback(entry.message(), source);
+            }
+        } else {
+            spdlog::warn("(File({}) | Ln({})) Midi Error: {}", source.file_name(), source.line(), entry.message());
+            if (m_warningCallback) {
+                m_warningCallback(entry.message(), source);
+            }
+        }
+    });
+}
+
+bool MidiDeviceManager::enableTrace(const std::string& path) {
+    auto trace = std::make_shared<MidiTraceSink>(path);
+    if (!trace->isOpen()) {
+        return false;
+    }
+
+    for (auto d : this->getAvailableDevices()) {
+        trace->addDevice(d, d->name());
+    }
+
+    m_trace.store(std::move(trace));
+    return true;
+}
+
+void MidiDeviceManager::disableTrace() {
+    // Stop here so the writer isn't joined by whichever input thread drops the last reference
+    if (auto trace = m_trace.exchange(nullptr)) {
+        trace->stop();
+    }
+}
+
+#ifdef MIDIREWORK_SHARED_BUS
+bool MidiDeviceManager::enableSharedBus(const std::string& name, size_t capacity) {
+    auto bus = std::make_shared<MidiSharedBusPublisher>(name, capacity);
+    if (!bus->isOpen()) {
+        return false;
+    }
+
+    for (auto d : this->getAvailableDevices()) {
+        bus->addDevice(d, d->name());
+    }
+
+    m_sharedBus.store(std::move(bus));
+    return true;
+}
+
+void MidiDeviceManager::disableSharedBus() {
+    m_sharedBus.store(nullptr);
+}
+#endif
+
+std::shared_ptr<MidiDevice> MidiDeviceManager::getDevice(MidiDeviceHandle handle) const {
+    return m_registry.get(handle);
+}
+
+size_t MidiDeviceManager::deviceSlotCount() const {
+    return m_registry.slotCount();
+}
+
 std::vector<MidiDevice*> MidiDeviceManager::getDevices() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     std::vector<MidiDevice*> result;
     result.reserve(m_devices.size());
 
@@ -279,10 +610,11 @@ std::vector<MidiDevice*> MidiDeviceManager::getDevices() {
 }
 
 std::vector<MidiDevice*> MidiDeviceManager::getAvailableDevices() {
+    auto devices = this->getDevices();
+
     std::vector<MidiDevice*> result;
-    result.reserve(m_devices.size());
+    result.reserve(devices.size());
 
-    auto devices = this->getDevices();
     std::copy_if(devices.begin(), devices.end(), std::back_inserter(result), [](MidiDevice *d) {
         return d->status() == Availability::Available;
     });
@@ -326,49 +658,210 @@ void MidiDeviceManager::scanPorts() {
     m_portManager.scan();
 }
 
-void MidiDeviceManager::handlePortRefresh() {
-    bool devicesChanged = false;
+MidiDeviceManager::DeviceSettings MidiDeviceManager::deviceSettings() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return DeviceSettings{
+        .recording = m_recording,
+        .recordingMode = m_recordingMode,
+        .recordingIndexed = m_recordingIndexed,
+        .statisticsEnabled = m_statisticsEnabled,
+        .noteStateEnabled = m_noteStateEnabled,
+        .transform = m_transform,
+        .realtimePriority = m_realtimePriority,
+    };
+}
+
+// An exception would end a refresh worker and with it the process, a port that
+// can't be opened is reported and the others still open
+void MidiDeviceManager::openDevice(const libremidi::input_port &in, const libremidi::output_port &out) {
+    std::string reason;
+    try {
+        createDevice(in, out);
+        return;
+    } catch (const std::exception &e) {
+        reason = e.what();
+    } catch (...) {
+        reason = "unknown exception";
+    }
 
-    auto inPorts = m_portManager.inputs();
-    auto outPorts = m_portManager.outputs();
+    const std::string info = "Opening " + in.port_name + " failed: " + reason;
+    const auto source = std::source_location::current();
+    spdlog::error("(File({}) | Ln({})) Midi Error: {}", source.file_name(), source.line(), info);
+    if (m_errorCallback) {
+        m_errorCallback(info, source);
+    }
+}
 
-    std::lock_guard<std::mutex> lock(m_mutex);
+// Runs on a refresh worker. The device is published once its ports are open
+// and its callbacks are in place.
+void MidiDeviceManager::createDevice(const libremidi::input_port &in, const libremidi::output_port &out) {
+    TraceSpan span("manager.createDevice");
+    auto device = std::allocate_shared<MidiDevice>(std::pmr::polymorphic_allocator<MidiDevice>(m_resource),
+                                                   in, out, m_captureCapacity.load(std::memory_order_relaxed), m_resource, m_backend);
+    device->setHandle(m_registry.add(device));
+    device->setRealtime(deviceSettings().realtimePriority);
 
-    for (auto &d : m_devices) {
-        d->close();
-        d->onVerified(nullptr);
-        d->onMessage(nullptr);
+    device->onMessage([this, device](MidiMessage &m) {
+        if (m_midiMessageCallback) {
+            m_midiMessageCallback(device.get(), m);
+        }
+    });
+
+    // Raw so trace and bus carry every message untransformed, SysEx and clock included
+    device->onRawMessage([this, d = device.get()](MidiMessage &m) {
+        if (auto trace = m_trace.read()) {
+            trace->log(d, m);
+        }
+#ifdef MIDIREWORK_SHARED_BUS
+        if (auto bus = m_sharedBus.read()) {
+            bus->publish(d, m);
+        }
+#endif
+    });
+
+    if (m_highResCallback) {
+        device->onHighResEvent([this, d = device.get()](const MidiHighResEvent &e) {
+            m_highResCallback(d, e);
+        });
     }
 
-    m_devices.clear();
+    // Each device is announced as soon as it has verified
+    device->onVerified([this, device](MidiMessage &m, Availability status) {
+        if (status == Availability::Available && device->nameOrdinal() == MidiDevice::NoOrdinal) {
+            device->setNameOrdinal(m_registry.acquireOrdinal(device->displayName()));
+        }
 
-    // Find matching ports in the updated lists
-    for (auto &in : inPorts) {
-        for (auto &out : outPorts) {
-            if (!portsMatch(in, out)) {
-                continue;
+        const auto settings = deviceSettings();
+        device->setRecordingMode(settings.recordingMode);
+        if (settings.recordingIndexed) {
+            device->enableRecordingIndex();
+        }
+        device->enableStatistics(settings.statisticsEnabled);
+        device->enableNoteState(settings.noteStateEnabled);
+        device->setTransform(settings.transform);
+        if (settings.recording) {
+            device->startRecording();
+        }
+
+        if (status == Availability::Available) {
+            if (auto trace = m_trace.load()) {
+                trace->addDevice(device.get(), device->name());
+            }
+#ifdef MIDIREWORK_SHARED_BUS
+            if (auto bus = m_sharedBus.load()) {
+                bus->addDevice(device.get(), device->name());
+            }
+#endif
+            if (m_deviceAddedCallback) {
+                m_deviceAddedCallback(device.get());
             }
+            m_deviceAddedWaiters.notify(device.get());
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_devices.push_back(std::move(device));
+}
 
-            auto device = std::make_shared<MidiDevice>(in, out);
-            m_devices.push_back(device);
+void MidiDeviceManager::handlePortRefresh() {
+    TraceSpan span("manager.refresh");
+    std::vector<std::shared_ptr<MidiDevice>> removed;
+    std::vector<std::pair<libremidi::input_port, libremidi::output_port>> added;
 
-            device->onMessage([this, device](MidiMessage &m) {
-                if (m_midiMessageCallback) {
-                    m_midiMessageCallback(device.get(), m);
-                }
+    auto inPorts = m_portManager.inputs();
+    auto outPorts = m_portManager.outputs();
+
+    // Only the bookkeeping happens under the lock, opening and closing ports
+    // can take milliseconds each and readers shouldn't wait for that
+    {
+        const int64_t waitStart = SpanTracer::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        SpanTracer::complete("manager.refresh.lock", waitStart, 0);
+
+        // Devices whose ports are still present stay open and verified
+        auto gone = std::stable_partition(m_devices.begin(), m_devices.end(), [&](const std::shared_ptr<MidiDevice> &d) {
+            bool hasIn = std::any_of(inPorts.begin(), inPorts.end(), [&d](const libremidi::input_port &p) {
+                return p.port_name == d->inPort().port_name;
+            });
+            bool hasOut = std::any_of(outPorts.begin(), outPorts.end(), [&d](const libremidi::output_port &p) {
+                return p.port_name == d->outPort().port_name;
             });
+            return hasIn && hasOut;
+        });
+
+        for (auto it = gone; it != m_devices.end(); ++it) {
+            m_registry.remove((*it)->handle());
+            removed.push_back(*it);
+        }
+        m_devices.erase(gone, m_devices.end());
 
-            device->onVerified([this, device](MidiMessage &m, Availability status) {
-                m_deviceAddedDebouncer.trigger(device.get());
+        // Find matching ports in the updated lists
+        for (auto &in : inPorts) {
+            for (auto &out : outPorts) {
+                if (!portsMatch(in, out)) {
+                    continue;
+                }
 
-                if (m_recording) {
-                    device->startRecording();
+                bool known = std::any_of(m_devices.begin(), m_devices.end(), [&](const std::shared_ptr<MidiDevice> &d) {
+                    return d->inPort().port_name == in.port_name && d->outPort().port_name == out.port_name;
+                });
+                if (!known) {
+                    added.emplace_back(in, out);
                 }
+            }
+        }
+    }
+
+    for (auto &d : removed) {
+        d->close();
+        d->onVerified(nullptr);
+        d->onMessage(nullptr);
+        d->onRawMessage(nullptr);
+        d->onHighResEvent(nullptr);
+        d->setThru(nullptr);
 
+        // Only now can no verification hand the device a new ordinal
+        if (d->nameOrdinal() != MidiDevice::NoOrdinal) {
+            m_registry.releaseOrdinal(d->displayName(), d->nameOrdinal());
+        }
+    }
+
+    // Each worker opens devices until none are left, so refresh time follows
+    // the slowest port rather than the sum of all of them
+    if (added.size() == 1) {
+        openDevice(added.front().first, added.front().second);
+    } else if (!added.empty()) {
+        std::atomic<size_t> next{0};
+        std::vector<std::jthread> workers;
+        const size_t count = std::min(added.size(), MaxOpeningThreads);
+        workers.reserve(count);
+        for (size_t w = 0; w < count; w++) {
+            workers.emplace_back([this, &added, &next]() {
+                for (size_t i = next++; i < added.size(); i = next++) {
+                    openDevice(added[i].first, added[i].second);
+                }
             });
+        }
+    }
 
-            devicesChanged = true;
+    const bool devicesChanged = !removed.empty() || !added.empty();
+
+    for (auto &d : removed) {
+        if (auto trace = m_trace.load()) {
+            trace->removeDevice(d.get());
+        }
+#ifdef MIDIREWORK_SHARED_BUS
+        if (auto bus = m_sharedBus.load()) {
+            bus->removeDevice(d.get());
         }
+#endif
+        if (d->status() == Availability::Available && m_deviceRemovedCallback) {
+            m_deviceRemovedCallback(d.get());
+        }
+    }
+
+    if (!removed.empty()) {
+        resolveRoutes();
     }
 
     if (devicesChanged) {
@@ -377,7 +870,43 @@ void MidiDeviceManager::handlePortRefresh() {
 }
 
 
-MidiManager::MidiManager()
-    : MidiDeviceManager()
+void MidiDeviceManager::checkLiveness(std::chrono::milliseconds probeInterval, std::chrono::milliseconds timeout) {
+    std::vector<std::shared_ptr<MidiDevice>> devices;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        devices.assign(m_devices.begin(), m_devices.end());
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    for (auto &d : devices) {
+        if (d->status() != Availability::Available) {
+            continue;
+        }
+
+        const auto idle = now - d->lastActivity();
+        const bool stalled = idle > timeout;
+
+        if (stalled != d->isStalled()) {
+            d->setStalled(stalled);
+            if (m_deviceStalledCallback) {
+                m_deviceStalledCallback(d.get(), stalled);
+            }
+        }
+
+        if (idle > probeInterval && !d->sendsActiveSensing()) {
+            d->probe();
+        }
+    }
+}
+
+
+MidiManager::MidiManager(std::pmr::memory_resource* resource)
+    : MidiDeviceManager(resource)
+{
+}
+
+MidiManager::MidiManager(MidiBackend backend, std::pmr::memory_resource* resource)
+    : MidiDeviceManager(backend, resource)
 {
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "Midi/MidiNoteState.h"
+#include "Midi/MidiDevice.h"
+
+
+MidiNoteState::MidiNoteState(MidiTransport& transport)
+    : m_transport(transport)
+{
+    for (auto& row : m_controllers) {
+        for (auto& value : row) {
+            value.store(Unset, std::memory_order_relaxed);
+        }
+    }
+}
+
+void MidiNoteState::add(const MidiMessage& msg) {
+    add(msg.bytes.data(), msg.size());
+}
+
+void MidiNoteState::add(const unsigned char* data, size_t size) {
+    if (size < 3) {
+        return;
+    }
+
+    const uint8_t channel = data[0] & 0x0F;
+    const uint8_t data1 = data[1] & 0x7F;
+    const uint8_t data2 = data[2] & 0x7F;
+
+    switch (data[0] & 0xF0) {
+        case 0x90:
+            setNote(channel, data1, data2 != 0);
+            break;
+        case 0x80:
+            setNote(channel, data1, false);
+            break;
+        case 0xB0:
+            m_controllers[channel][data1].store(data2, std::memory_order_relaxed);
+            // All Sound Off and All Notes Off
+            if (data1 == 120 || data1 == 123) {
+                m_notes[channel][0].store(0, std::memory_order_relaxed);
+                m_notes[channel][1].store(0, std::memory_order_relaxed);
+            }
+            break;
+    }
+}
+
+bool MidiNoteState::isHeld(uint8_t channel, uint8_t note) const noexcept {
+    if (channel >= 16 || note >= 128) {
+        return false;
+    }
+    return (m_notes[channel][note >> 6].load(std::memory_order_relaxed) >> (note & 63)) & 1;
+}
+
+MidiNoteSet MidiNoteState::held(uint8_t channel) const noexcept {
+    MidiNoteSet set;
+    if (channel < 16) {
+        set.words[0] = m_notes[channel][0].load(std::memory_order_relaxed);
+        set.words[1] = m_notes[channel][1].load(std::memory_order_relaxed);
+    }
+    return set;
+}
+
+size_t MidiNoteState::heldCount() const noexcept {
+    size_t count = 0;
+    for (const auto& channel : m_notes) {
+        count += std::popcount(channel[0].load(std::memory_order_relaxed));
+        count += std::popcount(channel[1].load(std::memory_order_relaxed));
+    }
+    return count;
+}
+
+std::optional<uint8_t> MidiNoteState::controller(uint8_t channel, uint8_t number) const noexcept {
+    if (channel >= 16 || number >= 128) {
+        return std::nullopt;
+    }
+    const uint8_t value = m_controllers[channel][number].load(std::memory_order_relaxed);
+    if (value == Unset) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+void MidiNoteState::releaseAll() {
+    for (uint8_t channel = 0; channel < 16; channel++) {
+        // Take the bits so a note is released once even if input races with us
+        MidiNoteSet set;
+        set.words[0] = m_notes[channel][0].exchange(0, std::memory_order_relaxed);
+        set.words[1] = m_notes[channel][1].exchange(0, std::memory_order_relaxed);
+
+        set.forEach([&](uint8_t note) {
+            m_transport.send({ static_cast<unsigned char>(0x80 | channel), note, 0 });
+        });
+    }
+}
+
+void MidiNoteState::clear() noexcept {
+    for (auto& channel : m_notes) {
+        channel[0].store(0, std::memory_order_relaxed);
+        channel[1].store(0, std::memory_order_relaxed);
+    }
+    for (auto& row : m_controllers) {
+        for (auto& value : row) {
+            value.store(Unset, std::memory_order_relaxed);
+        }
+    }
+}
+
+void MidiNoteState::operator()(MidiMessage& msg) {
+    add(msg);
+}
+
+void MidiNoteState::setNote(uint8_t channel, uint8_t note, bool on) noexcept {
+    const uint64_t bit = uint64_t{1} << (note & 63);
+    auto& word = m_notes[channel][note >> 6];
+
+    if (on) {
+        word.fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        word.fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,113 @@
+#include "Midi/MidiOutputEncoder.h"
+
+
+MidiOutputEncoder::MidiOutputEncoder() {
+    m_bytes.reserve(1024);
+    m_entries.reserve(256);
+    m_encoded.reserve(1024);
+}
+
+void MidiOutputEncoder::push(const unsigned char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(m_entries.size());
+    m_entries.push_back({ static_cast<uint32_t>(m_bytes.size()), static_cast<uint32_t>(size), false });
+    m_bytes.insert(m_bytes.end(), data, data + size);
+
+    m_stats.messagesIn++;
+    m_stats.bytesIn += size;
+
+    const unsigned char status = data[0];
+    const unsigned char type = status & 0xF0;
+    const size_t channel = status & 0x0F;
+
+    if (type == 0xB0 && size == 3 && coalescable(data[1])) {
+        supersede(m_controllers[channel * 128 + (data[1] & 0x7F)], index);
+    } else if (type == 0xE0 && size == 3) {
+        supersede(m_pitchBend[channel], index);
+    }
+}
+
+void MidiOutputEncoder::flush(const Sink& sink) {
+    if (m_entries.empty()) {
+        return;
+    }
+
+    unsigned char lastStatus = 0;
+    m_encoded.clear();
+
+    for (const Entry& entry : m_entries) {
+        if (entry.dropped) {
+            continue;
+        }
+
+        const unsigned char* data = m_bytes.data() + entry.offset;
+        const unsigned char status = data[0];
+
+        m_stats.messagesOut++;
+
+        if (!m_runningStatus) {
+            m_stats.bytesOut += entry.size;
+            if (sink) {
+                sink(data, entry.size);
+            }
+            continue;
+        }
+
+        size_t skip = 0;
+        if (status >= 0x80 && status < 0xF0) {
+            skip = status == lastStatus ? 1 : 0;
+            lastStatus = status;
+        } else if (status >= 0xF0 && status < 0xF8) {
+            // System common and SysEx cancel running status, realtime does not
+            lastStatus = 0;
+        }
+
+        m_encoded.insert(m_encoded.end(), data + skip, data + entry.size);
+    }
+
+    if (m_runningStatus) {
+        m_stats.bytesOut += m_encoded.size();
+        if (sink && !m_encoded.empty()) {
+            sink(m_encoded.data(), m_encoded.size());
+        }
+    }
+
+    clear();
+}
+
+void MidiOutputEncoder::clear() {
+    m_bytes.clear();
+    m_entries.clear();
+
+    // Invalidates every slot without touching the tables
+    if (++m_generation == 0) {
+        m_controllers.fill({});
+        m_pitchBend.fill({});
+        m_generation = 1;
+    }
+}
+
+// Controllers that are part of a sequence (bank select, data entry, NRPN/RPN
+// selection) or channel mode messages must all go out, even when repeated.
+bool MidiOutputEncoder::coalescable(unsigned char controller) noexcept {
+    switch (controller & 0x7F) {
+        case 0: case 32:                        // bank select
+        case 6: case 38:                        // data entry
+        case 96: case 97:                       // data increment / decrement
+        case 98: case 99: case 100: case 101:   // NRPN / RPN
+            return false;
+        default:
+            return (controller & 0x7F) < 120;
+    }
+}
+
+void MidiOutputEncoder::supersede(Slot& slot, uint32_t entry) noexcept {
+    if (slot.generation == m_generation) {
+        m_entries[slot.entry].dropped = true;
+    }
+    slot.generation = m_generation;
+    slot.entry = entry;
+}
@@ -0,0 +1,163 @@
+#include "Midi/MidiOutputScheduler.h"
+#include <algorithm>
+
+
+namespace {
+    // Bucket depth, how much unused budget may be saved up for a burst
+    constexpr double BurstSeconds = 0.01;
+
+    double burstFor(size_t bandwidth) noexcept {
+        return std::max(static_cast<double>(bandwidth) * BurstSeconds, 3.0);
+    }
+}
+
+
+MidiOutputScheduler::MidiOutputScheduler(Sink sink)
+    : m_sink(std::move(sink))
+    , m_thread([this] { run(); })
+{
+}
+
+MidiOutputScheduler::~MidiOutputScheduler() {
+    {
+        std::lock_guard lk(m_mutex);
+        m_stopping = true;
+        m_cv.notify_one();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void MidiOutputScheduler::schedule(std::vector<unsigned char> msg, Clock::time_point when, MidiOutputPriority priority) {
+    if (msg.empty()) {
+        return;
+    }
+
+    std::lock_guard lk(m_mutex);
+    Entry entry{ when, m_order++, std::move(msg) };
+
+    if (priority == MidiOutputPriority::Realtime) {
+        m_realtime.push(std::move(entry));
+    } else {
+        m_bulk.push(std::move(entry));
+    }
+
+    m_peakQueueDepth = std::max(m_peakQueueDepth, m_realtime.size() + m_bulk.size());
+    m_cv.notify_one();
+}
+
+void MidiOutputScheduler::clear() {
+    std::lock_guard lk(m_mutex);
+    m_realtime = Queue();
+    m_bulk = Queue();
+}
+
+void MidiOutputScheduler::setBandwidth(size_t bytesPerSecond) {
+    std::lock_guard lk(m_mutex);
+    m_bandwidth = bytesPerSecond;
+    m_tokens = 0.0;
+    m_lastRefill = Clock::now();
+    m_cv.notify_one();
+}
+
+MidiOutputStats MidiOutputScheduler::stats() const {
+    std::lock_guard lk(m_mutex);
+
+    MidiOutputStats result;
+    result.queueDepth = m_realtime.size() + m_bulk.size();
+    result.peakQueueDepth = m_peakQueueDepth;
+    result.sent = m_sent;
+    result.bytesSent = m_bytesSent;
+    result.averageLag = m_sent ? m_totalLag / static_cast<int64_t>(m_sent) : std::chrono::microseconds(0);
+    result.maxLag = m_maxLag;
+    return result;
+}
+
+MidiOutputPriority MidiOutputScheduler::classify(const std::vector<unsigned char>& msg) noexcept {
+    if (msg.empty()) {
+        return MidiOutputPriority::Bulk;
+    }
+
+    const unsigned char type = msg[0] & 0xF0;
+    return (type == 0x80 || type == 0x90) ? MidiOutputPriority::Realtime : MidiOutputPriority::Bulk;
+}
+
+void MidiOutputScheduler::run() {
+    std::unique_lock lk(m_mutex);
+
+    while (!m_stopping) {
+        const auto now = Clock::now();
+        refill(now);
+
+        if (!m_realtime.empty() && m_realtime.top().due <= now) {
+            Entry entry = std::move(const_cast<Entry&>(m_realtime.top()));
+            m_realtime.pop();
+            emit(entry, now, lk);
+            continue;
+        }
+
+        auto wakeup = Clock::time_point::max();
+        if (!m_realtime.empty()) {
+            wakeup = m_realtime.top().due;
+        }
+
+        if (!m_bulk.empty()) {
+            const Entry& next = m_bulk.top();
+            const size_t bandwidth = m_bandwidth;
+
+            if (next.due <= now) {
+                // Messages larger than the bucket go out once it is full and overdraw it
+                const double size = std::min(static_cast<double>(next.bytes.size()), burstFor(bandwidth));
+                if (bandwidth == 0 || m_tokens >= size) {
+                    Entry entry = std::move(const_cast<Entry&>(next));
+                    m_bulk.pop();
+                    emit(entry, now, lk);
+                    continue;
+                }
+
+                const auto wait = std::chrono::duration<double>((size - m_tokens) / static_cast<double>(bandwidth));
+                wakeup = std::min(wakeup, now + std::chrono::duration_cast<Clock::duration>(wait));
+            } else {
+                wakeup = std::min(wakeup, next.due);
+            }
+        }
+
+        if (wakeup == Clock::time_point::max()) {
+            m_cv.wait(lk);
+        } else {
+            m_cv.wait_until(lk, wakeup);
+        }
+    }
+}
+
+void MidiOutputScheduler::refill(Clock::time_point now) {
+    const size_t bandwidth = m_bandwidth;
+    if (bandwidth == 0) {
+        m_lastRefill = now;
+        return;
+    }
+
+    const double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+    m_tokens = std::min(m_tokens + elapsed * static_cast<double>(bandwidth), burstFor(bandwidth));
+    m_lastRefill = now;
+}
+
+void MidiOutputScheduler::emit(Entry& entry, Clock::time_point now, std::unique_lock<std::mutex>& lk) {
+    if (m_bandwidth != 0) {
+        m_tokens -= static_cast<double>(entry.bytes.size());
+    }
+
+    const auto lag = std::chrono::duration_cast<std::chrono::microseconds>(now - std::min(now, entry.due));
+    m_sent++;
+    m_bytesSent += entry.bytes.size();
+    m_totalLag += lag;
+    m_maxLag = std::max(m_maxLag, lag);
+
+    // The sink may block on the backend, don't hold up producers meanwhile
+    lk.unlock();
+    if (m_sink) {
+        m_sink(entry.bytes.data(), entry.bytes.size());
+    }
+    lk.lock();
+}
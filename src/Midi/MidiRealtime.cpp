@@ -0,0 +1,127 @@
+#include "Midi/MidiRealtime.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+
+bool MidiRealtime::lockMemory() {
+#if defined(_WIN32)
+    spdlog::warn("Realtime: locking memory is not supported on Windows");
+    return false;
+#else
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        spdlog::warn("Realtime: mlockall failed: {}", std::strerror(errno));
+        return false;
+    }
+    return true;
+#endif
+}
+
+void MidiRealtime::unlockMemory() {
+#if !defined(_WIN32)
+    munlockall();
+#endif
+}
+
+MidiRealtime::Scheduling MidiRealtime::currentThreadScheduling() noexcept {
+#if defined(_WIN32)
+    return { 0, GetThreadPriority(GetCurrentThread()) };
+#else
+    Scheduling scheduling;
+    sched_param param{};
+    if (pthread_getschedparam(pthread_self(), &scheduling.policy, &param) == 0) {
+        scheduling.priority = param.sched_priority;
+    }
+    return scheduling;
+#endif
+}
+
+bool MidiRealtime::setCurrentThreadScheduling(const Scheduling& scheduling) noexcept {
+#if defined(_WIN32)
+    return SetThreadPriority(GetCurrentThread(), scheduling.priority) != 0;
+#else
+    sched_param param{};
+    param.sched_priority = scheduling.priority;
+    return pthread_setschedparam(pthread_self(), scheduling.policy, &param) == 0;
+#endif
+}
+
+bool MidiRealtime::setCurrentThreadPriority(int priority) noexcept {
+#if defined(_WIN32)
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    sched_param param{};
+    param.sched_priority = std::clamp(priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+
+MidiDeferredLog& MidiDeferredLog::instance() {
+    static MidiDeferredLog log;
+    return log;
+}
+
+MidiDeferredLog::MidiDeferredLog() {
+    for (size_t i = 0; i < Capacity; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// A cell is free for position pos when its sequence is pos and holds an entry
+// once it is pos + 1. Producers claim positions by CAS on the head.
+bool MidiDeferredLog::post(Level level, std::string_view text, const std::source_location& location) noexcept {
+    size_t pos = m_head.load(std::memory_order_relaxed);
+    Cell* cell;
+
+    for (;;) {
+        cell = &m_cells[pos % Capacity];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->entry.level = level;
+    cell->entry.length = static_cast<uint8_t>(std::min(text.size(), TextSize));
+    std::memcpy(cell->entry.text, text.data(), cell->entry.length);
+    cell->entry.location = location;
+
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool MidiDeferredLog::pop(Entry& entry) noexcept {
+    Cell& cell = m_cells[m_tail % Capacity];
+    if (cell.sequence.load(std::memory_order_acquire) != m_tail + 1) {
+        return false;
+    }
+
+    entry = cell.entry;
+    cell.sequence.store(m_tail + Capacity, std::memory_order_release);
+    m_tail++;
+    return true;
+}
+
+uint64_t MidiDeferredLog::dropped() const noexcept {
+    return m_dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,136 @@
+#include "Midi/MidiRecordingIndex.h"
+#include <algorithm>
+#include <utility>
+
+
+namespace {
+    // The lists can't be copied or moved, each one is built in place
+    template<typename T, typename Make, size_t... I>
+    std::array<T, sizeof...(I)> makeArray(const Make& make, std::index_sequence<I...>) {
+        return { ((void)I, make())... };
+    }
+
+    template<typename T, size_t N, typename Make>
+    std::array<T, N> makeArray(const Make& make) {
+        return makeArray<T>(make, std::make_index_sequence<N>());
+    }
+}
+
+
+MidiRecordingIndex::MidiRecordingIndex(std::pmr::memory_resource* resource)
+    : m_channel(makeArray<PostingList, 16>([resource] { return PostingList(resource); }))
+    , m_noteOn(makeArray<std::array<PostingList, 128>, 16>([resource] {
+        return makeArray<PostingList, 128>([resource] { return PostingList(resource); });
+    }))
+    , m_noteOff(makeArray<std::array<PostingList, 128>, 16>([resource] {
+        return makeArray<PostingList, 128>([resource] { return PostingList(resource); });
+    }))
+    , m_controlChange(makeArray<std::array<PostingList, 128>, 16>([resource] {
+        return makeArray<PostingList, 128>([resource] { return PostingList(resource); });
+    }))
+{
+}
+
+void MidiRecordingIndex::add(const MidiMessageRecord& record) {
+    const uint32_t position = m_next++;
+    const auto& msg = record.message;
+
+    if (msg.size() == 0 || msg[0] < 0x80 || msg[0] >= 0xF0) {
+        return;
+    }
+
+    const uint8_t type = msg[0] & 0xF0;
+    const uint8_t channel = msg[0] & 0x0F;
+
+    m_channel[channel].push_back(position);
+
+    if (msg.size() < 3) {
+        return;
+    }
+
+    const uint8_t number = msg[1] & 0x7F;
+
+    if (type == 0x90 && msg[2] > 0) {
+        m_noteOn[channel][number].push_back(position);
+    } else if (type == 0x80 || type == 0x90) {
+        m_noteOff[channel][number].push_back(position);
+    } else if (type == 0xB0) {
+        m_controlChange[channel][number].push_back(position);
+    }
+}
+
+void MidiRecordingIndex::clear() {
+    m_next = 0;
+
+    for (auto& list : m_channel) {
+        list.clear();
+    }
+    for (auto* table : { &m_noteOn, &m_noteOff, &m_controlChange }) {
+        for (auto& lists : *table) {
+            for (auto& list : lists) {
+                list.clear();
+            }
+        }
+    }
+}
+
+MidiQueryResult MidiRecordingIndex::query(const MidiQuery& query, const AppendLog<MidiMessageRecord>& records) const {
+    const PostingList* list = postingsFor(query);
+
+    if (query.kind != MidiQuery::Kind::All && list == nullptr) {
+        return {};
+    }
+
+    // Postings first: every position they hold is then covered by the record snapshot.
+    MidiQueryResult::PostingSnapshot postings;
+    if (list) {
+        postings = list->snapshot();
+    }
+    MidiRecordingSnapshot snapshot = records.snapshot();
+
+    if (query.kind == MidiQuery::Kind::All) {
+        auto first = std::partition_point(snapshot.begin(), snapshot.end(), [&query](const MidiMessageRecord& r) {
+            return r.timestamp < query.from;
+        });
+        auto last = std::partition_point(first, snapshot.end(), [&query](const MidiMessageRecord& r) {
+            return r.timestamp < query.to;
+        });
+
+        const size_t firstPos = static_cast<size_t>(first - snapshot.begin());
+        const size_t lastPos = static_cast<size_t>(last - snapshot.begin());
+        return MidiQueryResult(std::move(snapshot), firstPos, lastPos);
+    }
+
+    auto end = std::partition_point(postings.begin(), postings.end(), [&snapshot](uint32_t pos) {
+        return pos < snapshot.size();
+    });
+    auto first = std::partition_point(postings.begin(), end, [&](uint32_t pos) {
+        return snapshot[pos].timestamp < query.from;
+    });
+    auto last = std::partition_point(first, end, [&](uint32_t pos) {
+        return snapshot[pos].timestamp < query.to;
+    });
+
+    const size_t firstPos = static_cast<size_t>(first - postings.begin());
+    const size_t lastPos = static_cast<size_t>(last - postings.begin());
+    return MidiQueryResult(std::move(snapshot), std::move(postings), firstPos, lastPos);
+}
+
+const MidiRecordingIndex::PostingList* MidiRecordingIndex::postingsFor(const MidiQuery& query) const noexcept {
+    if (query.channel < 1 || query.channel > 16 || query.number < 0 || query.number > 127) {
+        return nullptr;
+    }
+
+    const size_t channel = static_cast<size_t>(query.channel - 1);
+    const size_t number = static_cast<size_t>(query.number);
+
+    switch (query.kind) {
+        case MidiQuery::Kind::Channel:       return &m_channel[channel];
+        case MidiQuery::Kind::NoteOn:        return &m_noteOn[channel][number];
+        case MidiQuery::Kind::NoteOff:       return &m_noteOff[channel][number];
+        case MidiQuery::Kind::ControlChange: return &m_controlChange[channel][number];
+        case MidiQuery::Kind::All:           break;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,341 @@
+#include "Midi/MidiSharedBus.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+using namespace MidiSharedBusLayout;
+
+namespace {
+    int64_t steadyNow() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+
+MidiSharedBusPublisher::MidiSharedBusPublisher(std::string name, size_t capacity)
+    : m_name(std::move(name))
+{
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 2));
+    const size_t size = segmentSize(capacity);
+
+    // Never take over a segment that exists, another publisher may be using
+    // it and the destructor would unlink it from under its readers
+    const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        spdlog::error("Shared bus: {} already exists, another publisher owns it or a crashed one left it behind "
+                      "(remove it with shm_unlink or from /dev/shm)", m_name);
+        return;
+    }
+    if (fd < 0) {
+        spdlog::error("Shared bus: shm_open({}) failed: {}", m_name, std::strerror(errno));
+        return;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        spdlog::error("Shared bus: resizing {} failed: {}", m_name, std::strerror(errno));
+        close(fd);
+        shm_unlink(m_name.c_str());
+        return;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        spdlog::error("Shared bus: mapping {} failed: {}", m_name, std::strerror(errno));
+        shm_unlink(m_name.c_str());
+        return;
+    }
+
+    // ftruncate on a new segment zero fills it
+    m_memory = memory;
+    m_size = size;
+    m_header = new (memory) Header{};
+    m_slots = reinterpret_cast<Slot*>(static_cast<char*>(memory) + sizeof(Header));
+    m_mask = capacity - 1;
+
+    m_header->magic = Magic;
+    m_header->version = Version;
+    m_header->capacity = capacity;
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+MidiSharedBusPublisher::~MidiSharedBusPublisher() {
+    if (m_memory) {
+        munmap(m_memory, m_size);
+        shm_unlink(m_name.c_str());
+    }
+}
+
+bool MidiSharedBusPublisher::isOpen() const noexcept {
+    return m_memory != nullptr;
+}
+
+const std::string& MidiSharedBusPublisher::name() const noexcept {
+    return m_name;
+}
+
+bool MidiSharedBusPublisher::addDevice(const void* key, std::string_view name) {
+    if (!isOpen()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_tableMutex);
+    if (find(key) >= 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < MaxDevices; i++) {
+        if (m_keys[i].load(std::memory_order_relaxed) == nullptr) {
+            writeTable(i, true, name);
+            m_keys[i].store(key, std::memory_order_release);
+            return true;
+        }
+    }
+
+    spdlog::warn("Shared bus: device table full, {} is not published", name);
+    return false;
+}
+
+void MidiSharedBusPublisher::removeDevice(const void* key) {
+    if (!isOpen()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_tableMutex);
+    const int index = find(key);
+    if (index < 0) {
+        return;
+    }
+
+    m_keys[index].store(nullptr, std::memory_order_release);
+    writeTable(static_cast<size_t>(index), false, {});
+}
+
+void MidiSharedBusPublisher::publish(const void* key, const MidiMessage& msg) {
+    if (!isOpen() || msg.size() == 0 || msg.size() > MidiSharedEvent::MaxBytes) {
+        return;
+    }
+
+    const int device = find(key);
+    if (device < 0) {
+        return;
+    }
+
+    uint8_t bytes[MidiSharedEvent::MaxBytes] = {};
+    std::memcpy(bytes, msg.bytes.data(), msg.size());
+
+    uint64_t header = static_cast<uint64_t>(device) | (static_cast<uint64_t>(msg.size()) << 16);
+    for (size_t i = 0; i < 5; i++) {
+        header |= static_cast<uint64_t>(bytes[i]) << (24 + 8 * i);
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; i < 8; i++) {
+        tail |= static_cast<uint64_t>(bytes[5 + i]) << (8 * i);
+    }
+
+    const uint64_t sequence = m_header->head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[sequence & m_mask];
+
+    slot.state.store(2 * sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestamp.store(steadyNow(), std::memory_order_relaxed);
+    slot.header.store(header, std::memory_order_relaxed);
+    slot.tail.store(tail, std::memory_order_relaxed);
+
+    slot.state.store(2 * sequence + 2, std::memory_order_release);
+}
+
+int MidiSharedBusPublisher::find(const void* key) const noexcept {
+    for (size_t i = 0; i < MaxDevices; i++) {
+        if (m_keys[i].load(std::memory_order_acquire) == key) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void MidiSharedBusPublisher::writeTable(size_t index, bool active, std::string_view name) {
+    const uint64_t sequence = m_header->tableSequence.load(std::memory_order_relaxed);
+    m_header->tableSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Device& device = m_header->devices[index];
+    for (size_t w = 0; w < NameWords; w++) {
+        uint64_t word = 0;
+        for (size_t c = 0; c < 8; c++) {
+            const size_t i = w * 8 + c;
+            if (i < name.size()) {
+                word |= static_cast<uint64_t>(static_cast<uint8_t>(name[i])) << (8 * c);
+            }
+        }
+        device.name[w].store(word, std::memory_order_relaxed);
+    }
+    device.active.store(active ? 1 : 0, std::memory_order_relaxed);
+
+    m_header->tableSequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+MidiSharedBusReader::MidiSharedBusReader(std::string name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        spdlog::error("Shared bus: shm_open({}) failed: {}", name, std::strerror(errno));
+        return;
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        spdlog::error("Shared bus: {} is not a bus segment", name);
+        close(fd);
+        return;
+    }
+
+    const size_t size = static_cast<size_t>(info.st_size);
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        spdlog::error("Shared bus: mapping {} failed: {}", name, std::strerror(errno));
+        return;
+    }
+
+    const auto* header = static_cast<const Header*>(memory);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != Magic || header->version != Version || segmentSize(header->capacity) > size) {
+        spdlog::error("Shared bus: {} has an unknown layout", name);
+        munmap(memory, size);
+        return;
+    }
+
+    m_memory = memory;
+    m_size = size;
+    m_header = header;
+    m_slots = reinterpret_cast<const Slot*>(static_cast<const char*>(memory) + sizeof(Header));
+    m_mask = header->capacity - 1;
+
+    // Start with live events rather than replaying the ring
+    m_next = header->head.load(std::memory_order_acquire);
+}
+
+MidiSharedBusReader::~MidiSharedBusReader() {
+    if (m_memory) {
+        munmap(m_memory, m_size);
+    }
+}
+
+bool MidiSharedBusReader::isOpen() const noexcept {
+    return m_memory != nullptr;
+}
+
+std::vector<MidiSharedDevice> MidiSharedBusReader::devices() const {
+    std::vector<MidiSharedDevice> result;
+    if (!isOpen()) {
+        return result;
+    }
+
+    for (;;) {
+        const uint64_t before = m_header->tableSequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        result.clear();
+        for (size_t i = 0; i < MaxDevices; i++) {
+            const Device& device = m_header->devices[i];
+            if (!device.active.load(std::memory_order_relaxed)) {
+                continue;
+            }
+
+            MidiSharedDevice entry;
+            entry.index = static_cast<uint16_t>(i);
+            for (size_t w = 0; w < NameWords; w++) {
+                const uint64_t word = device.name[w].load(std::memory_order_relaxed);
+                for (size_t c = 0; c < 8; c++) {
+                    const char ch = static_cast<char>((word >> (8 * c)) & 0xFF);
+                    if (ch == '\0') {
+                        break;
+                    }
+                    entry.name.push_back(ch);
+                }
+            }
+            result.push_back(std::move(entry));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_header->tableSequence.load(std::memory_order_relaxed) == before) {
+            return result;
+        }
+    }
+}
+
+bool MidiSharedBusReader::read(MidiSharedEvent& event) {
+    if (!isOpen()) {
+        return false;
+    }
+
+    for (;;) {
+        const uint64_t head = m_header->head.load(std::memory_order_acquire);
+        if (m_next >= head) {
+            return false;
+        }
+
+        const uint64_t capacity = m_mask + 1;
+        if (head - m_next > capacity) {
+            m_dropped += head - capacity - m_next;
+            m_next = head - capacity;
+        }
+
+        const Slot& slot = m_slots[m_next & m_mask];
+        const uint64_t state = slot.state.load(std::memory_order_acquire);
+
+        if (state < 2 * m_next + 2) {
+            // Claimed but not written yet, the writer is mid publish
+            return false;
+        }
+        if (state > 2 * m_next + 2) {
+            // Already overwritten by a later lap
+            m_dropped++;
+            m_next++;
+            continue;
+        }
+
+        const int64_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        const uint64_t header = slot.header.load(std::memory_order_relaxed);
+        const uint64_t tail = slot.tail.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.state.load(std::memory_order_relaxed) != state) {
+            m_dropped++;
+            m_next++;
+            continue;
+        }
+
+        event.sequence = m_next;
+        event.timestamp = timestamp;
+        event.device = static_cast<uint16_t>(header & 0xFFFF);
+        event.size = static_cast<uint8_t>(std::min<uint64_t>((header >> 16) & 0xFF, MidiSharedEvent::MaxBytes));
+        for (size_t i = 0; i < 5; i++) {
+            event.bytes[i] = static_cast<uint8_t>(header >> (24 + 8 * i));
+        }
+        for (size_t i = 0; i < 8; i++) {
+            event.bytes[5 + i] = static_cast<uint8_t>(tail >> (8 * i));
+        }
+
+        m_next++;
+        return true;
+    }
+}
+
+uint64_t MidiSharedBusReader::dropped() const noexcept {
+    return m_dropped;
+}
@@ -0,0 +1,137 @@
+#include "Midi/MidiStatistics.h"
+#include <algorithm>
+
+
+namespace {
+    template<typename T>
+    void bump(std::atomic<T>& counter) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    void copyTable(ChannelTable<T>& out, const ChannelTable<std::atomic<T>>& in) noexcept {
+        for (size_t c = 0; c < 16; c++) {
+            for (size_t n = 0; n < 128; n++) {
+                out[c][n] = in[c][n].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template<typename T>
+    void clearTable(ChannelTable<std::atomic<T>>& table) noexcept {
+        for (auto& row : table) {
+            for (auto& value : row) {
+                value.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+
+MidiStatistics::MidiStatistics(MidiTransport& transport)
+    : m_transport(transport)
+{
+}
+
+void MidiStatistics::add(const MidiMessage& msg) {
+    if (msg.size() == 0) {
+        return;
+    }
+
+    const uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (m_resetRequested.exchange(false, std::memory_order_relaxed)) {
+        clearCounters();
+    }
+
+    const auto now = Clock::now();
+    const auto secondStart = m_secondStart.load(std::memory_order_relaxed);
+    if (now - secondStart >= std::chrono::seconds(1)) {
+        // The counted second is complete either way, but a gap of more than
+        // one second means the last full second was empty
+        const uint32_t counted = m_currentSecondCount.load(std::memory_order_relaxed);
+        m_eventsPerSecond.store(now - secondStart < std::chrono::seconds(2) ? counted : 0, std::memory_order_relaxed);
+        if (counted > m_peakEventsPerSecond.load(std::memory_order_relaxed)) {
+            m_peakEventsPerSecond.store(counted, std::memory_order_relaxed);
+        }
+        m_secondStart.store(now, std::memory_order_relaxed);
+        m_currentSecondCount.store(0, std::memory_order_relaxed);
+    }
+    bump(m_currentSecondCount);
+    bump(m_totalEvents);
+
+    const uint8_t status = msg[0];
+    if (msg.size() == 3 && status >= 0x80 && status < 0xF0) {
+        const uint8_t type = status & 0xF0;
+        const size_t channel = status & 0x0F;
+        const size_t data1 = msg[1] & 0x7F;
+        const uint8_t data2 = msg[2] & 0x7F;
+
+        if (type == 0x90 && data2 > 0) {
+            bump(m_noteCounts[channel][data1]);
+            bump(m_velocityHistogram[channel][data2]);
+        } else if (type == 0xB0) {
+            bump(m_controlChangeCounts[channel][data1]);
+            m_controlChangeValues[channel][data1].store(data2, std::memory_order_relaxed);
+        }
+    }
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+MidiStatisticsSnapshot MidiStatistics::snapshot() const {
+    MidiStatisticsSnapshot result{};
+    if (m_resetRequested.load(std::memory_order_relaxed)) {
+        return result;
+    }
+
+    Clock::time_point secondStart;
+    uint32_t current = 0;
+    for (;;) {
+        const uint64_t before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        copyTable(result.noteCounts, m_noteCounts);
+        copyTable(result.velocityHistogram, m_velocityHistogram);
+        copyTable(result.controlChangeCounts, m_controlChangeCounts);
+        copyTable(result.controlChangeValues, m_controlChangeValues);
+        result.totalEvents = m_totalEvents.load(std::memory_order_relaxed);
+        result.eventsPerSecond = m_eventsPerSecond.load(std::memory_order_relaxed);
+        result.peakEventsPerSecond = m_peakEventsPerSecond.load(std::memory_order_relaxed);
+        secondStart = m_secondStart.load(std::memory_order_relaxed);
+        current = m_currentSecondCount.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+
+    // Same rule as add(), applied as if an event arrived now, so the rate
+    // drops once the input goes quiet
+    const auto age = Clock::now() - secondStart;
+    if (age >= std::chrono::seconds(1)) {
+        result.eventsPerSecond = age < std::chrono::seconds(2) ? current : 0;
+        result.peakEventsPerSecond = std::max(result.peakEventsPerSecond, current);
+    }
+    return result;
+}
+
+void MidiStatistics::operator()(MidiMessage& msg) {
+    add(msg);
+}
+
+void MidiStatistics::clearCounters() {
+    clearTable(m_noteCounts);
+    clearTable(m_velocityHistogram);
+    clearTable(m_controlChangeCounts);
+    clearTable(m_controlChangeValues);
+    m_totalEvents.store(0, std::memory_order_relaxed);
+    m_eventsPerSecond.store(0, std::memory_order_relaxed);
+    m_peakEventsPerSecond.store(0, std::memory_order_relaxed);
+    m_currentSecondCount.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,70 @@
+#include "Midi/MidiThru.h"
+#include "Midi/MidiDevice.h"
+
+
+MidiThruTable::MidiThruTable(std::vector<Target> targets)
+    : m_targets(std::move(targets))
+{}
+
+size_t MidiThruTable::forward(const MidiMessage& msg) const {
+    if (msg.size() == 0) {
+        return 0;
+    }
+
+    const uint8_t status = msg[0];
+    const uint8_t type = MidiRoute::typeBit(status);
+    const bool voice = status >= 0x80 && status < 0xF0;
+    const uint16_t channelBit = voice ? static_cast<uint16_t>(1 << (status & 0x0F)) : MidiRoute::AllChannels;
+
+    size_t sent = 0;
+    for (const Target& target : m_targets) {
+        if (!(target.types & type) || !(target.channels & channelBit)) {
+            continue;
+        }
+
+        if (voice && target.channel != MidiRoute::KeepChannel && msg.size() <= 3) {
+            unsigned char bytes[3];
+            bytes[0] = static_cast<unsigned char>((status & 0xF0) | (target.channel & 0x0F));
+            for (size_t i = 1; i < msg.size(); i++) {
+                bytes[i] = msg[i];
+            }
+            target.device->forward(bytes, msg.size());
+        } else {
+            target.device->forward(msg.bytes.data(), msg.size());
+        }
+        sent++;
+    }
+    return sent;
+}
+
+
+void MidiThruMeter::record(std::chrono::nanoseconds elapsed) noexcept {
+    const int64_t ns = elapsed.count();
+
+    m_forwarded.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(ns, std::memory_order_relaxed);
+    if (ns > m_max.load(std::memory_order_relaxed)) {
+        m_max.store(ns, std::memory_order_relaxed);
+    }
+    if (elapsed > Budget) {
+        m_overBudget.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+MidiThruStats MidiThruMeter::stats() const noexcept {
+    MidiThruStats stats;
+    stats.forwarded = m_forwarded.load(std::memory_order_relaxed);
+    stats.overBudget = m_overBudget.load(std::memory_order_relaxed);
+    stats.max = std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed));
+    if (stats.forwarded > 0) {
+        stats.mean = std::chrono::nanoseconds(m_total.load(std::memory_order_relaxed) / static_cast<int64_t>(stats.forwarded));
+    }
+    return stats;
+}
+
+void MidiThruMeter::reset() noexcept {
+    m_forwarded.store(0, std::memory_order_relaxed);
+    m_overBudget.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
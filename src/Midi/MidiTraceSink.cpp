@@ -0,0 +1,233 @@
+#include "Midi/MidiTraceSink.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+    int64_t steadyNow() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+
+MidiTraceSink::MidiTraceSink(const std::string& path, std::chrono::milliseconds flushInterval, size_t queueCapacity)
+    : m_flushInterval(flushInterval)
+    , m_queueCapacity(queueCapacity)
+{
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        spdlog::error("Trace: cannot open {}: {}", path, std::strerror(errno));
+        return;
+    }
+
+    std::fwrite(MidiTraceFormat::Magic, 1, sizeof(MidiTraceFormat::Magic), m_file);
+    m_thread = std::jthread([this] { run(); });
+}
+
+MidiTraceSink::~MidiTraceSink() {
+    stop();
+}
+
+bool MidiTraceSink::isOpen() const noexcept {
+    return m_file != nullptr;
+}
+
+bool MidiTraceSink::addDevice(const void* key, std::string_view name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_file || find(key) >= 0) {
+        return m_file != nullptr;
+    }
+    if (m_deviceCount == MaxDevices) {
+        spdlog::warn("Trace: device table full, {} is not traced", name);
+        return false;
+    }
+
+    const size_t index = m_deviceCount++;
+    m_queueStorage[index] = std::make_unique<Queue>(m_queueCapacity);
+    m_queues[index].store(m_queueStorage[index].get(), std::memory_order_release);
+    m_keys[index].store(key, std::memory_order_release);
+    m_published.store(m_deviceCount, std::memory_order_release);
+    m_pendingDevices.emplace_back(static_cast<uint16_t>(index), std::string(name));
+
+    return true;
+}
+
+void MidiTraceSink::removeDevice(const void* key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The queue stays until the sink stops so pending events still get written
+    const int index = find(key);
+    if (index >= 0) {
+        m_keys[index].store(nullptr, std::memory_order_release);
+    }
+}
+
+void MidiTraceSink::log(const void* key, const MidiMessage& msg) noexcept {
+    const int device = find(key);
+    if (device < 0) {
+        return;
+    }
+
+    Queue* queue = m_queues[device].load(std::memory_order_acquire);
+
+    MidiTraceRecord record;
+    record.timestamp = steadyNow();
+    record.device = static_cast<uint16_t>(device);
+    record.size = static_cast<uint8_t>(std::min<size_t>(msg.size(), 255));
+    std::memset(record.bytes, 0, sizeof(record.bytes));
+    std::memcpy(record.bytes, msg.bytes.data(), std::min(msg.size(), MidiTraceRecord::InlineBytes));
+
+    // try_enqueue never allocates, a full queue drops the event
+    if (!queue->try_enqueue(record)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int MidiTraceSink::find(const void* key) const noexcept {
+    const size_t count = m_published.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        if (m_keys[i].load(std::memory_order_acquire) == key) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+uint64_t MidiTraceSink::dropped() const noexcept {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void MidiTraceSink::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_cv.notify_one();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+void MidiTraceSink::run() {
+    std::vector<MidiTraceRecord> batch;
+    batch.reserve(m_queueCapacity);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+        m_cv.wait_for(lock, m_flushInterval, [this] { return m_stopping; });
+        const bool stopping = m_stopping;
+
+        auto devices = std::move(m_pendingDevices);
+        m_pendingDevices.clear();
+        lock.unlock();
+
+        for (const auto& [index, name] : devices) {
+            std::vector<char> payload(sizeof(uint16_t) + name.size());
+            std::memcpy(payload.data(), &index, sizeof(uint16_t));
+            std::memcpy(payload.data() + sizeof(uint16_t), name.data(), name.size());
+            writeChunk(MidiTraceFormat::DeviceChunk, payload.data(), payload.size());
+        }
+
+        drain(batch);
+        if (!batch.empty()) {
+            writeChunk(MidiTraceFormat::EventChunk, batch.data(), batch.size() * sizeof(MidiTraceRecord));
+            batch.clear();
+        }
+        std::fflush(m_file);
+
+        lock.lock();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void MidiTraceSink::drain(std::vector<MidiTraceRecord>& batch) {
+    MidiTraceRecord record;
+    for (auto& slot : m_queues) {
+        Queue* queue = slot.load(std::memory_order_acquire);
+        if (!queue) {
+            continue;
+        }
+        while (queue->try_dequeue(record)) {
+            batch.push_back(record);
+        }
+    }
+
+    std::stable_sort(batch.begin(), batch.end(), [](const MidiTraceRecord& a, const MidiTraceRecord& b) {
+        return a.timestamp < b.timestamp;
+    });
+}
+
+void MidiTraceSink::writeChunk(uint32_t kind, const void* data, size_t size) {
+    const uint32_t length = static_cast<uint32_t>(size);
+    std::fwrite(&kind, sizeof(kind), 1, m_file);
+    std::fwrite(&length, sizeof(length), 1, m_file);
+    std::fwrite(data, 1, size, m_file);
+}
+
+
+MidiTraceReader::MidiTraceReader(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        spdlog::error("Trace: cannot open {}: {}", path, std::strerror(errno));
+        return;
+    }
+
+    char magic[sizeof(MidiTraceFormat::Magic)];
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, MidiTraceFormat::Magic, sizeof(magic)) != 0) {
+        spdlog::error("Trace: {} is not a trace file", path);
+        std::fclose(file);
+        return;
+    }
+
+    uint32_t header[2];
+    std::vector<char> payload;
+    while (std::fread(header, sizeof(uint32_t), 2, file) == 2) {
+        payload.resize(header[1]);
+        if (std::fread(payload.data(), 1, payload.size(), file) != payload.size()) {
+            spdlog::warn("Trace: {} ends in a truncated chunk", path);
+            break;
+        }
+
+        if (header[0] == MidiTraceFormat::DeviceChunk && payload.size() >= sizeof(uint16_t)) {
+            uint16_t index;
+            std::memcpy(&index, payload.data(), sizeof(index));
+            if (m_devices.size() <= index) {
+                m_devices.resize(index + 1);
+            }
+            m_devices[index].assign(payload.data() + sizeof(index), payload.size() - sizeof(index));
+        } else if (header[0] == MidiTraceFormat::EventChunk) {
+            const size_t count = payload.size() / sizeof(MidiTraceRecord);
+            const size_t first = m_records.size();
+            m_records.resize(first + count);
+            std::memcpy(m_records.data() + first, payload.data(), count * sizeof(MidiTraceRecord));
+        }
+    }
+
+    std::fclose(file);
+    m_open = true;
+}
+
+bool MidiTraceReader::isOpen() const noexcept {
+    return m_open;
+}
+
+const std::vector<std::string>& MidiTraceReader::devices() const noexcept {
+    return m_devices;
+}
+
+const std::vector<MidiTraceRecord>& MidiTraceReader::records() const noexcept {
+    return m_records;
+}
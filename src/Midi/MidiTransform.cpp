@@ -0,0 +1,393 @@
+#include "Midi/MidiTransform.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(MIDIREWORK_ENABLE_AVX2) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+#define MIDI_TRANSFORM_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+
+// Every kernel takes the status, data1 and data2 lanes. The AVX2 loop handles
+// 32 events at a time, the scalar loop does the rest and is the whole kernel
+// when the CPU has no AVX2. Both compute the same masks so the results match.
+//
+// Only the AVX2 functions are compiled for AVX2, through the target attribute,
+// and they are only called after a runtime check. Building the whole file with
+// -mavx2 would also compile the inline library code it instantiates for AVX2,
+// and the linker may keep those copies for the entire program.
+namespace {
+    bool isNote(uint8_t status) noexcept {
+        const uint8_t type = status >> 4;
+        return type == 0x8 || type == 0x9 || type == 0xA;
+    }
+
+    bool isVoice(uint8_t status) noexcept {
+        return status >= 0x80 && status < 0xF0;
+    }
+
+#if defined(MIDI_TRANSFORM_AVX2)
+    bool cpuHasAvx2() noexcept {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool osSaves = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        return osSaves && (info[1] & (1 << 5));
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    const bool g_avx2 = cpuHasAvx2();
+
+    AVX2_TARGET inline __m256i load(const uint8_t* p) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    AVX2_TARGET inline void store(uint8_t* p, __m256i v) noexcept {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+    }
+
+    AVX2_TARGET inline __m256i typeOf(__m256i status) noexcept {
+        return _mm256_and_si256(_mm256_srli_epi16(status, 4), _mm256_set1_epi8(0x0F));
+    }
+
+    AVX2_TARGET inline __m256i noteMask(__m256i type) noexcept {
+        return _mm256_or_si256(_mm256_or_si256(
+            _mm256_cmpeq_epi8(type, _mm256_set1_epi8(0x8)),
+            _mm256_cmpeq_epi8(type, _mm256_set1_epi8(0x9))),
+            _mm256_cmpeq_epi8(type, _mm256_set1_epi8(0xA)));
+    }
+
+    AVX2_TARGET inline __m256i voiceMask(__m256i type) noexcept {
+        return _mm256_andnot_si256(_mm256_cmpeq_epi8(type, _mm256_set1_epi8(0xF)),
+                                   _mm256_cmpgt_epi8(type, _mm256_set1_epi8(0x7)));
+    }
+
+    AVX2_TARGET inline __m256i withChannel(__m256i status, __m256i channel) noexcept {
+        return _mm256_or_si256(_mm256_and_si256(status, _mm256_set1_epi8(static_cast<char>(0xF0))), channel);
+    }
+
+    // 128 entry table as eight 16 byte shuffles, each selected by the index' high nibble
+    AVX2_TARGET inline __m256i lookup(const uint8_t* table, __m256i index) noexcept {
+        index = _mm256_and_si256(index, _mm256_set1_epi8(0x7F));
+        const __m256i low = _mm256_and_si256(index, _mm256_set1_epi8(0x0F));
+        const __m256i high = _mm256_and_si256(_mm256_srli_epi16(index, 4), _mm256_set1_epi8(0x0F));
+
+        __m256i result = _mm256_setzero_si256();
+        for (int k = 0; k < 8; k++) {
+            const __m256i part = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16 * k)));
+            const __m256i select = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(static_cast<char>(k)));
+            result = _mm256_or_si256(result, _mm256_and_si256(select, _mm256_shuffle_epi8(part, low)));
+        }
+        return result;
+    }
+
+    // Each returns how many events it handled, the scalar kernel does the rest
+    AVX2_TARGET size_t splitAvx2(uint8_t* status, const uint8_t* data1, size_t count, const MidiTransform::Split& split) {
+        size_t i = 0;
+        const __m256i low = _mm256_set1_epi8(static_cast<char>(split.low));
+        const __m256i high = _mm256_set1_epi8(static_cast<char>(split.high));
+        const __m256i channel = _mm256_set1_epi8(static_cast<char>(split.channel & 0x0F));
+        for (; i + 32 <= count; i += 32) {
+            const __m256i s = load(status + i);
+            const __m256i d1 = load(data1 + i);
+            const __m256i inRange = _mm256_andnot_si256(
+                _mm256_or_si256(_mm256_cmpgt_epi8(low, d1), _mm256_cmpgt_epi8(d1, high)),
+                noteMask(typeOf(s)));
+            store(status + i, _mm256_blendv_epi8(s, withChannel(s, channel), inRange));
+        }
+        return i;
+    }
+
+    AVX2_TARGET size_t channelMapAvx2(uint8_t* status, size_t count, const std::array<uint8_t, 16>& map) {
+        size_t i = 0;
+        const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(map.data())));
+        for (; i + 32 <= count; i += 32) {
+            const __m256i s = load(status + i);
+            const __m256i mapped = _mm256_shuffle_epi8(table, _mm256_and_si256(s, _mm256_set1_epi8(0x0F)));
+            store(status + i, _mm256_blendv_epi8(s, withChannel(s, mapped), voiceMask(typeOf(s))));
+        }
+        return i;
+    }
+
+    AVX2_TARGET size_t transposeAvx2(const uint8_t* status, uint8_t* data1, size_t count, int8_t semitones) {
+        size_t i = 0;
+        const __m256i offset = _mm256_set1_epi8(semitones);
+        for (; i + 32 <= count; i += 32) {
+            const __m256i d1 = load(data1 + i);
+            const __m256i moved = _mm256_max_epi8(_mm256_adds_epi8(d1, offset), _mm256_setzero_si256());
+            store(data1 + i, _mm256_blendv_epi8(d1, moved, noteMask(typeOf(load(status + i)))));
+        }
+        return i;
+    }
+
+    AVX2_TARGET size_t velocityAvx2(const uint8_t* status, uint8_t* data2, size_t count, const MidiTransform::Curve& curve) {
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const __m256i d2 = load(data2 + i);
+            const __m256i noteOn = _mm256_andnot_si256(
+                _mm256_cmpeq_epi8(d2, _mm256_setzero_si256()),
+                _mm256_cmpeq_epi8(typeOf(load(status + i)), _mm256_set1_epi8(0x9)));
+            const __m256i mapped = _mm256_max_epu8(lookup(curve.data(), d2), _mm256_set1_epi8(1));
+            store(data2 + i, _mm256_blendv_epi8(d2, mapped, noteOn));
+        }
+        return i;
+    }
+
+    AVX2_TARGET size_t controllerAvx2(const uint8_t* status, const uint8_t* data1, uint8_t* data2, size_t count,
+                                      uint8_t controller, const MidiTransform::Curve& curve) {
+        size_t i = 0;
+        const __m256i number = _mm256_set1_epi8(static_cast<char>(controller));
+        for (; i + 32 <= count; i += 32) {
+            const __m256i d2 = load(data2 + i);
+            const __m256i match = _mm256_and_si256(
+                _mm256_cmpeq_epi8(typeOf(load(status + i)), _mm256_set1_epi8(0xB)),
+                _mm256_cmpeq_epi8(load(data1 + i), number));
+            store(data2 + i, _mm256_blendv_epi8(d2, lookup(curve.data(), d2), match));
+        }
+        return i;
+    }
+#endif
+
+    void splitKernel(uint8_t* status, const uint8_t* data1, size_t count, const MidiTransform::Split& split) {
+        size_t i = 0;
+#if defined(MIDI_TRANSFORM_AVX2)
+        if (g_avx2) {
+            i = splitAvx2(status, data1, count, split);
+        }
+#endif
+        for (; i < count; i++) {
+            if (isNote(status[i]) && data1[i] >= split.low && data1[i] <= split.high) {
+                status[i] = static_cast<uint8_t>((status[i] & 0xF0) | (split.channel & 0x0F));
+            }
+        }
+    }
+
+    void channelMapKernel(uint8_t* status, size_t count, const std::array<uint8_t, 16>& map) {
+        size_t i = 0;
+#if defined(MIDI_TRANSFORM_AVX2)
+        if (g_avx2) {
+            i = channelMapAvx2(status, count, map);
+        }
+#endif
+        for (; i < count; i++) {
+            if (isVoice(status[i])) {
+                status[i] = static_cast<uint8_t>((status[i] & 0xF0) | map[status[i] & 0x0F]);
+            }
+        }
+    }
+
+    void transposeKernel(const uint8_t* status, uint8_t* data1, size_t count, int8_t semitones) {
+        size_t i = 0;
+#if defined(MIDI_TRANSFORM_AVX2)
+        if (g_avx2) {
+            i = transposeAvx2(status, data1, count, semitones);
+        }
+#endif
+        for (; i < count; i++) {
+            if (isNote(status[i])) {
+                data1[i] = static_cast<uint8_t>(std::clamp(data1[i] + semitones, 0, 127));
+            }
+        }
+    }
+
+    void velocityKernel(const uint8_t* status, uint8_t* data2, size_t count, const MidiTransform::Curve& curve) {
+        size_t i = 0;
+#if defined(MIDI_TRANSFORM_AVX2)
+        if (g_avx2) {
+            i = velocityAvx2(status, data2, count, curve);
+        }
+#endif
+        for (; i < count; i++) {
+            if ((status[i] >> 4) == 0x9 && data2[i] != 0) {
+                data2[i] = std::max<uint8_t>(curve[data2[i] & 0x7F], 1);
+            }
+        }
+    }
+
+    void controllerKernel(const uint8_t* status, const uint8_t* data1, uint8_t* data2, size_t count,
+                          uint8_t controller, const MidiTransform::Curve& curve) {
+        size_t i = 0;
+#if defined(MIDI_TRANSFORM_AVX2)
+        if (g_avx2) {
+            i = controllerAvx2(status, data1, data2, count, controller, curve);
+        }
+#endif
+        for (; i < count; i++) {
+            if ((status[i] >> 4) == 0xB && data1[i] == controller) {
+                data2[i] = curve[data2[i] & 0x7F];
+            }
+        }
+    }
+}
+
+
+void MidiEventBlock::reserve(size_t count) {
+    timestamp.reserve(count);
+    status.reserve(count);
+    data1.reserve(count);
+    data2.reserve(count);
+    length.reserve(count);
+}
+
+void MidiEventBlock::clear() noexcept {
+    timestamp.clear();
+    status.clear();
+    data1.clear();
+    data2.clear();
+    length.clear();
+    extended.clear();
+}
+
+void MidiEventBlock::push(const MidiMessage& msg, int64_t time) {
+    timestamp.push_back(time);
+
+    if (msg.size() > 3 || msg.size() == 0) {
+        status.push_back(0xF0);
+        data1.push_back(0);
+        data2.push_back(0);
+        length.push_back(Extended);
+        extended.push_back(msg);
+        return;
+    }
+
+    status.push_back(msg[0]);
+    data1.push_back(msg.size() > 1 ? msg[1] : 0);
+    data2.push_back(msg.size() > 2 ? msg[2] : 0);
+    length.push_back(static_cast<uint8_t>(msg.size()));
+}
+
+MidiMessage MidiEventBlock::message(size_t index, size_t& extendedIndex) const {
+    if (length[index] == Extended) {
+        return extended[extendedIndex++];
+    }
+
+    const uint8_t bytes[3] = { status[index], data1[index], data2[index] };
+    MidiMessage msg;
+    msg.bytes.assign(bytes, bytes + length[index]);
+    msg.timestamp = timestamp[index];
+    return msg;
+}
+
+std::vector<MidiMessageRecord> MidiEventBlock::toRecords() const {
+    std::vector<MidiMessageRecord> records;
+    records.reserve(size());
+
+    size_t extendedIndex = 0;
+    for (size_t i = 0; i < size(); i++) {
+        MidiMessageRecord record;
+        record.message = message(i, extendedIndex);
+        record.timestamp = timestamp[i];
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+
+MidiTransform::MidiTransform() {
+    for (size_t i = 0; i < m_velocityCurve.size(); i++) {
+        m_velocityCurve[i] = static_cast<uint8_t>(i);
+    }
+    for (size_t i = 0; i < m_channelMap.size(); i++) {
+        m_channelMap[i] = static_cast<uint8_t>(i);
+    }
+}
+
+void MidiTransform::setTranspose(int8_t semitones) noexcept {
+    m_transpose = semitones;
+}
+
+void MidiTransform::setVelocityCurve(const Curve& curve) noexcept {
+    m_velocityCurve = curve;
+    m_curveSet = true;
+}
+
+void MidiTransform::setVelocityCurve(float exponent) noexcept {
+    Curve curve;
+    for (size_t v = 0; v < curve.size(); v++) {
+        curve[v] = static_cast<uint8_t>(std::lround(127.0 * std::pow(v / 127.0, exponent)));
+    }
+    setVelocityCurve(curve);
+}
+
+void MidiTransform::setChannelMap(const std::array<uint8_t, 16>& map) noexcept {
+    for (size_t i = 0; i < map.size(); i++) {
+        m_channelMap[i] = map[i] & 0x0F;
+    }
+    m_channelMapSet = true;
+}
+
+void MidiTransform::addSplit(Split split) {
+    m_splits.push_back(split);
+}
+
+void MidiTransform::scaleController(uint8_t controller, uint8_t min, uint8_t max) {
+    ControllerScale scale;
+    scale.controller = controller & 0x7F;
+    for (int v = 0; v < 128; v++) {
+        scale.curve[v] = static_cast<uint8_t>(std::lround(min + (max - min) * (v / 127.0)));
+    }
+    m_controllerScales.push_back(scale);
+}
+
+bool MidiTransform::isIdentity() const noexcept {
+    return m_transpose == 0 && !m_curveSet && !m_channelMapSet && m_splits.empty() && m_controllerScales.empty();
+}
+
+void MidiTransform::apply(MidiEventBlock& block) const {
+    apply(block.status.data(), block.data1.data(), block.data2.data(), block.size());
+}
+
+void MidiTransform::apply(MidiMessage& msg) const {
+    if (msg.size() == 0 || msg.size() > 3) {
+        return;
+    }
+
+    uint8_t status = msg[0];
+    uint8_t data1 = msg.size() > 1 ? msg[1] : 0;
+    uint8_t data2 = msg.size() > 2 ? msg[2] : 0;
+    apply(&status, &data1, &data2, 1);
+
+    msg.bytes[0] = status;
+    if (msg.size() > 1) msg.bytes[1] = data1;
+    if (msg.size() > 2) msg.bytes[2] = data2;
+}
+
+std::vector<MidiMessageRecord> MidiTransform::apply(const MidiRecordingSnapshot& snapshot) const {
+    MidiEventBlock block = MidiEventBlock::fromRecords(snapshot);
+    apply(block);
+    return block.toRecords();
+}
+
+void MidiTransform::apply(uint8_t* status, uint8_t* data1, uint8_t* data2, size_t count) const {
+    for (const Split& split : m_splits) {
+        splitKernel(status, data1, count, split);
+    }
+    if (m_channelMapSet) {
+        channelMapKernel(status, count, m_channelMap);
+    }
+    if (m_transpose != 0) {
+        transposeKernel(status, data1, count, m_transpose);
+    }
+    if (m_curveSet) {
+        velocityKernel(status, data2, count, m_velocityCurve);
+    }
+    for (const ControllerScale& scale : m_controllerScales) {
+        controllerKernel(status, data1, data2, count, scale.controller, scale.curve);
+    }
+}
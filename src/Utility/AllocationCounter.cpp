@@ -0,0 +1,110 @@
+#include "Utility/AllocationCounter.h"
+
+#ifdef MIDIREWORK_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+
+namespace {
+    thread_local int t_depth = 0;
+
+    std::atomic<uint64_t> g_allocations{0};
+    std::atomic<uint64_t> g_bytes{0};
+
+    void count(std::size_t size) noexcept {
+        if (t_depth > 0) {
+            g_allocations.fetch_add(1, std::memory_order_relaxed);
+            g_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+
+    void* allocate(std::size_t size, std::size_t alignment = 0) noexcept {
+        count(size);
+        if (size == 0) {
+            size = 1;
+        }
+        if (alignment > alignof(std::max_align_t)) {
+            // aligned_alloc wants a multiple of the alignment
+            return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        }
+        return std::malloc(size);
+    }
+}
+
+
+AllocationCounter::Counts AllocationCounter::total() noexcept {
+    return { g_allocations.load(std::memory_order_relaxed), g_bytes.load(std::memory_order_relaxed) };
+}
+
+void AllocationCounter::reset() noexcept {
+    g_allocations.store(0, std::memory_order_relaxed);
+    g_bytes.store(0, std::memory_order_relaxed);
+}
+
+void AllocationCounter::enterScope() noexcept {
+    t_depth++;
+}
+
+void AllocationCounter::exitScope() noexcept {
+    t_depth--;
+}
+
+bool AllocationCounter::inScope() noexcept {
+    return t_depth > 0;
+}
+
+int AllocationCounter::suspendScope() noexcept {
+    const int depth = t_depth;
+    t_depth = 0;
+    return depth;
+}
+
+void AllocationCounter::resumeScope(int depth) noexcept {
+    t_depth = depth;
+}
+
+
+void* operator new(std::size_t size) {
+    if (void* p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* p = allocate(size, static_cast<std::size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
@@ -0,0 +1,62 @@
+#include "Utility/RealtimeChecker.h"
+
+#if defined(MIDIREWORK_REALTIME_CHECKS) && defined(__linux__)
+#include <atomic>
+#include <dlfcn.h>
+#include <pthread.h>
+
+
+namespace {
+    using MutexLock = int (*)(pthread_mutex_t*);
+    using RwLock = int (*)(pthread_rwlock_t*);
+
+    std::atomic<uint64_t> g_locks{0};
+
+    // Looked up before main so no lock call has to resolve them lazily
+    MutexLock g_mutexLock = reinterpret_cast<MutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    RwLock g_readLock = reinterpret_cast<RwLock>(dlsym(RTLD_NEXT, "pthread_rwlock_rdlock"));
+    RwLock g_writeLock = reinterpret_cast<RwLock>(dlsym(RTLD_NEXT, "pthread_rwlock_wrlock"));
+
+    void count() noexcept {
+        if (AllocationCounter::inScope()) {
+            g_locks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+RealtimeChecker::Violations RealtimeChecker::total() noexcept {
+    return { AllocationCounter::total().allocations, g_locks.load(std::memory_order_relaxed) };
+}
+
+void RealtimeChecker::reset() noexcept {
+    AllocationCounter::reset();
+    g_locks.store(0, std::memory_order_relaxed);
+}
+
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (!g_mutexLock) {
+        g_mutexLock = reinterpret_cast<MutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    }
+    count();
+    return g_mutexLock(mutex);
+}
+
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    if (!g_readLock) {
+        g_readLock = reinterpret_cast<RwLock>(dlsym(RTLD_NEXT, "pthread_rwlock_rdlock"));
+    }
+    count();
+    return g_readLock(lock);
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    if (!g_writeLock) {
+        g_writeLock = reinterpret_cast<RwLock>(dlsym(RTLD_NEXT, "pthread_rwlock_wrlock"));
+    }
+    count();
+    return g_writeLock(lock);
+}
+
+#endif
@@ -0,0 +1,255 @@
+#include "Utility/SpanTracer.h"
+
+#ifdef MIDIREWORK_ENABLE_TRACING
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+    enum class Kind : uint8_t { Complete, Instant, FlowStart, FlowEnd };
+
+    struct Span {
+        int64_t start;
+        int64_t end;
+        const char* name;
+        uint64_t id;
+        uint32_t thread;
+        Kind kind;
+    };
+
+    // Relaxed atomics so a dump can read a slot its thread is overwriting, the
+    // dump then finds the slot was reused and leaves it out
+    struct Slot {
+        std::atomic<int64_t> start{0};
+        std::atomic<int64_t> end{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> id{0};
+        std::atomic<uint32_t> thread{0};
+        std::atomic<Kind> kind{Kind::Complete};
+    };
+
+    // A ring written only by the thread holding it. `written` counts every span
+    // ever recorded and is published after the span, once it passes the
+    // capacity the oldest spans are overwritten.
+    struct Buffer {
+        std::atomic<uint64_t> written{0};
+        std::array<Slot, SpanTracer::BufferCapacity> slots;
+    };
+
+    std::mutex g_buffersMutex;
+    std::vector<std::unique_ptr<Buffer>> g_buffers;
+    std::vector<Buffer*> g_freeBuffers;
+    std::map<uint32_t, std::string> g_threadNames;
+    uint32_t g_nextThread = 1;
+    std::atomic<uint64_t> g_nextId{1};
+
+    // Hands the buffer back when its thread exits, the spans stay in it until a
+    // new thread picks it up and overwrites them. Threads that come and go, like
+    // the refresh workers, reuse the same few buffers.
+    struct ThreadBuffer {
+        Buffer* buffer{nullptr};
+        uint32_t thread{0};
+
+        ~ThreadBuffer() {
+            if (buffer) {
+                std::lock_guard<std::mutex> lock(g_buffersMutex);
+                g_freeBuffers.push_back(buffer);
+            }
+        }
+    };
+
+    thread_local ThreadBuffer t_buffer;
+
+    ThreadBuffer& buffer() {
+        if (!t_buffer.buffer) {
+            std::unique_ptr<Buffer> owned;
+            {
+                std::lock_guard<std::mutex> lock(g_buffersMutex);
+                t_buffer.thread = g_nextThread++;
+                if (!g_freeBuffers.empty()) {
+                    t_buffer.buffer = g_freeBuffers.back();
+                    g_freeBuffers.pop_back();
+                    return t_buffer;
+                }
+            }
+
+            // Allocated outside the lock, it is over a megabyte
+            owned = std::make_unique<Buffer>();
+            std::lock_guard<std::mutex> lock(g_buffersMutex);
+            t_buffer.buffer = owned.get();
+            g_buffers.push_back(std::move(owned));
+        }
+        return t_buffer;
+    }
+
+    void record(Kind kind, const char* name, int64_t start, int64_t end, uint64_t id) noexcept {
+        ThreadBuffer& t = buffer();
+        Buffer& b = *t.buffer;
+        const uint64_t index = b.written.load(std::memory_order_relaxed);
+        Slot& slot = b.slots[index % b.slots.size()];
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.id.store(id, std::memory_order_relaxed);
+        slot.thread.store(t.thread, std::memory_order_relaxed);
+        slot.kind.store(kind, std::memory_order_relaxed);
+        b.written.store(index + 1, std::memory_order_release);
+    }
+
+    // Copies the spans still in the ring, oldest first. Slots overwritten while
+    // copying are dropped by checking `written` again afterwards.
+    void snapshot(const Buffer& b, std::vector<Span>& out) {
+        const size_t capacity = b.slots.size();
+        const uint64_t before = b.written.load(std::memory_order_acquire);
+        const uint64_t first = before > capacity ? before - capacity : 0;
+
+        const size_t begin = out.size();
+        for (uint64_t i = first; i < before; i++) {
+            const Slot& slot = b.slots[i % capacity];
+            out.push_back(Span{
+                slot.start.load(std::memory_order_relaxed),
+                slot.end.load(std::memory_order_relaxed),
+                slot.name.load(std::memory_order_relaxed),
+                slot.id.load(std::memory_order_relaxed),
+                slot.thread.load(std::memory_order_relaxed),
+                slot.kind.load(std::memory_order_relaxed),
+            });
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = b.written.load(std::memory_order_relaxed);
+        if (after > first + capacity) {
+            const uint64_t reused = std::min<uint64_t>(after - capacity - first, before - first);
+            out.erase(out.begin() + begin, out.begin() + begin + static_cast<size_t>(reused));
+        }
+    }
+}
+
+
+int64_t SpanTracer::now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SpanTracer::complete(const char* name, int64_t start, uint64_t id) noexcept {
+    record(Kind::Complete, name, start, now(), id);
+}
+
+void SpanTracer::instant(const char* name, uint64_t id) noexcept {
+    const int64_t t = now();
+    record(Kind::Instant, name, t, t, id);
+}
+
+void SpanTracer::flowStart(const char* name, uint64_t id) noexcept {
+    const int64_t t = now();
+    record(Kind::FlowStart, name, t, t, id);
+}
+
+void SpanTracer::flowEnd(const char* name, uint64_t id) noexcept {
+    const int64_t t = now();
+    record(Kind::FlowEnd, name, t, t, id);
+}
+
+uint64_t SpanTracer::nextId() noexcept {
+    return g_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SpanTracer::nameThread(std::string_view name) {
+    const uint32_t thread = buffer().thread;
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    g_threadNames[thread] = name;
+}
+
+uint64_t SpanTracer::overwritten() {
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    uint64_t total = 0;
+    for (const auto& b : g_buffers) {
+        const uint64_t written = b->written.load(std::memory_order_relaxed);
+        total += written > b->slots.size() ? written - b->slots.size() : 0;
+    }
+    return total;
+}
+
+bool SpanTracer::writeChromeTrace(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        spdlog::error("Span trace: cannot open {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    std::vector<Span> spans;
+    std::map<uint32_t, std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        for (const auto& b : g_buffers) {
+            snapshot(*b, spans);
+        }
+        names = g_threadNames;
+    }
+
+    // Timestamps are microseconds from the first span so the viewer starts at zero
+    int64_t origin = INT64_MAX;
+    for (const Span& span : spans) {
+        origin = std::min(origin, span.start);
+        names.try_emplace(span.thread, "thread");
+    }
+    auto us = [origin](int64_t t) { return static_cast<double>(t - origin) / 1000.0; };
+
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) {
+            std::fputs(",\n", file);
+        }
+        first = false;
+    };
+
+    for (const auto& [thread, name] : names) {
+        separator();
+        std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     thread, name.c_str());
+    }
+
+    for (const Span& span : spans) {
+        const auto id = static_cast<unsigned long long>(span.id);
+        separator();
+        switch (span.kind) {
+            case Kind::Complete:
+                std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"id\":%llu}}",
+                             span.name, span.thread, us(span.start), (span.end - span.start) / 1000.0, id);
+                break;
+            case Kind::Instant:
+                std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"id\":%llu}}",
+                             span.name, span.thread, us(span.start), id);
+                break;
+            case Kind::FlowStart:
+                std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"flow\",\"ph\":\"s\",\"id\":%llu,\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                             span.name, id, span.thread, us(span.start));
+                break;
+            case Kind::FlowEnd:
+                // Binds to the span enclosing it rather than the next one
+                std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"flow\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%llu,\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                             span.name, id, span.thread, us(span.start));
+                break;
+        }
+    }
+
+    std::fputs("\n]}\n", file);
+    const bool ok = std::fclose(file) == 0;
+
+    const uint64_t lost = overwritten();
+    if (lost) {
+        spdlog::info("Span trace: {} older spans were overwritten, the trace holds the most recent ones", lost);
+    }
+    return ok;
+}
+#endif
@@ -1,24 +1,41 @@
 #include <iostream>
+#include <string_view>
 #include <libremidi/libremidi.hpp>
 #include <spdlog/spdlog.h>
 
 #include "Midi/MidiManager.h"
 #include "Midi/MidiDevice.h"
 
-int main() {
+int main(int argc, char** argv) {
     spdlog::set_level(spdlog::level::debug);
 
+    // --trace <file> writes a binary log instead of printing every message,
+    // read it back with midi-trace-dump. --spans <file> writes the recorded
+    // hot path spans as Chrome trace JSON on exit (MIDIREWORK_ENABLE_TRACING).
+    const char* tracePath = nullptr;
+    const char* spansPath = nullptr;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--trace") {
+            tracePath = argv[i + 1];
+        } else if (std::string_view(argv[i]) == "--spans") {
+            spansPath = argv[i + 1];
+        }
+    }
+
     MidiManager manager;
     manager.startRecording();
 
-
-    manager.onMidiMessage([](MidiDevice* device, MidiMessage& msg) {
-        std::ostringstream ss;
-        for (int i = 0; i < msg.size(); i++) {
-            ss << (int)msg[i] << " ";
-        }
-        spdlog::info("From {} | Channel: {} | Type: {} | Message: {}", device->displayName(), msg.get_channel(), (int)msg.get_message_type(), ss.str());
-    });
+    if (tracePath && manager.enableTrace(tracePath)) {
+        spdlog::info("Tracing to {}", tracePath);
+    } else {
+        manager.onMidiMessage([](MidiDevice* device, MidiMessage& msg) {
+            std::ostringstream ss;
+            for (int i = 0; i < msg.size(); i++) {
+                ss << (int)msg[i] << " ";
+            }
+            spdlog::info("From {} | Channel: {} | Type: {} | Message: {}", device->displayName(), msg.get_channel(), (int)msg.get_message_type(), ss.str());
+        });
+    }
     manager.onDeviceAdded([](MidiDevice* device) {
         spdlog::info("Device added: {}", device->name());
         std::ostringstream ss;
@@ -33,11 +50,20 @@ int main() {
 
     std::cin.get();
 
+    manager.disableTrace();
     manager.stopRecording();
 
-    for (auto recording : manager.recorded()) {
+    if (spansPath) {
+        if (!SpanTracer::Enabled) {
+            spdlog::warn("Built without MIDIREWORK_ENABLE_TRACING, no spans to write");
+        } else if (SpanTracer::writeChromeTrace(spansPath)) {
+            spdlog::info("Spans written to {}", spansPath);
+        }
+    }
+
+    for (const auto& recording : manager.recorded()) {
         spdlog::info("Device: {}", recording.first);
-        for (auto msg : recording.second) {
+        for (const auto& msg : recording.second) {
             std::ostringstream ss;
             for (int i = 0; i < msg.message.size(); i++) {
                 ss << (int)msg.message[i] << " ";
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Midi/MidiBackend.h"
+
+// Loopback round trips through each available backend. A virtual input port is
+// opened and then reached through the backend's own port listing, so every
+// message leaves through a midi_out and comes back through the backend's input
+// thread. Reports latency percentiles and jitter (standard deviation).
+//
+// ALSA raw has no virtual ports, load snd-virmidi and pass --loopback with a
+// name matching both ends, or use a cable between two physical ports. JACK
+// needs a running server, `jackd -d dummy` is enough.
+//
+//   midi-backend-latency [--count 5000] [--interval-us 1000] [--loopback name]
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Poly pressure is passed through unchanged by every backend; note on with
+    // velocity 0 would be rewritten to note off by the ALSA sequencer
+    constexpr unsigned char Status = 0xA0;
+    constexpr size_t MaxCount = size_t(1) << 18;
+    constexpr std::string_view VirtualName = "midirework-latency";
+
+    struct Options {
+        size_t count = 5000;
+        std::chrono::microseconds interval{1000};
+        std::string loopback;
+    };
+
+    struct Result {
+        size_t sent = 0;
+        std::vector<double> latencies;      // microseconds
+    };
+
+    void encode(size_t sequence, unsigned char* bytes) {
+        bytes[0] = static_cast<unsigned char>(Status | ((sequence >> 14) & 0x0F));
+        bytes[1] = static_cast<unsigned char>((sequence >> 7) & 0x7F);
+        bytes[2] = static_cast<unsigned char>(sequence & 0x7F);
+    }
+
+    long decode(const libremidi::message& msg) {
+        if (msg.size() != 3 || (msg.bytes[0] & 0xF0) != Status) {
+            return -1;
+        }
+        return static_cast<long>(msg.bytes[0] & 0x0F) << 14 | msg.bytes[1] << 7 | msg.bytes[2];
+    }
+
+    bool matches(const libremidi::port_information& port, std::string_view name) {
+        return port.port_name.find(name) != std::string::npos || port.display_name.find(name) != std::string::npos;
+    }
+
+    template<typename Port>
+    const Port* findPort(const std::vector<Port>& ports, std::string_view name) {
+        auto it = std::find_if(ports.begin(), ports.end(), [name](const Port& port) { return matches(port, name); });
+        return it != ports.end() ? &*it : nullptr;
+    }
+
+    bool run(MidiBackend backend, const Options& options, Result& result) {
+        std::vector<Clock::time_point> sent(options.count);
+        std::vector<Clock::time_point> received(options.count);
+        std::atomic<size_t> arrived{0};
+
+        libremidi::input_configuration config;
+        config.on_message = [&](libremidi::message&& msg) {
+            const auto now = Clock::now();
+            const long sequence = decode(msg);
+            if (sequence >= 0 && static_cast<size_t>(sequence) < received.size()) {
+                received[sequence] = now;
+                arrived.fetch_add(1, std::memory_order_release);
+            }
+        };
+        auto in = MidiBackends::makeInput(config, backend);
+        auto out = MidiBackends::makeOutput(libremidi::output_configuration{}, backend);
+        auto observer = MidiBackends::makeObserver(libremidi::observer_configuration{}, backend);
+
+        if (options.loopback.empty()) {
+            if (in.open_virtual_port(VirtualName)) {
+                std::printf("  no virtual ports, skipped (try --loopback)\n");
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+            const auto* port = findPort(observer.get_output_ports(), VirtualName);
+            if (!port || out.open_port(*port)) {
+                std::printf("  virtual port not reachable, skipped\n");
+                return false;
+            }
+        } else {
+            const auto* inPort = findPort(observer.get_input_ports(), options.loopback);
+            const auto* outPort = findPort(observer.get_output_ports(), options.loopback);
+            if (!inPort || !outPort || in.open_port(*inPort) || out.open_port(*outPort)) {
+                std::printf("  no ports matching \"%s\", skipped\n", options.loopback.c_str());
+                return false;
+            }
+        }
+
+        unsigned char bytes[3];
+        auto next = Clock::now();
+        for (size_t i = 0; i < options.count; i++) {
+            std::this_thread::sleep_until(next);
+            next += options.interval;
+
+            encode(i, bytes);
+            sent[i] = Clock::now();
+            out.send_message(bytes, sizeof(bytes));
+        }
+
+        const auto deadline = Clock::now() + std::chrono::seconds(2);
+        while (arrived.load(std::memory_order_acquire) < options.count && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        in.close_port();
+        out.close_port();
+
+        result.sent = options.count;
+        for (size_t i = 0; i < options.count; i++) {
+            if (received[i] != Clock::time_point{}) {
+                result.latencies.push_back(std::chrono::duration<double, std::micro>(received[i] - sent[i]).count());
+            }
+        }
+        return !result.latencies.empty();
+    }
+
+    void report(Result& result) {
+        auto& values = result.latencies;
+        std::sort(values.begin(), values.end());
+
+        auto percentile = [&values](double p) {
+            const size_t index = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+            return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+        };
+
+        double sum = 0;
+        for (double v : values) {
+            sum += v;
+        }
+        const double mean = sum / values.size();
+        double variance = 0;
+        for (double v : values) {
+            variance += (v - mean) * (v - mean);
+        }
+        const double jitter = std::sqrt(variance / values.size());
+
+        std::printf("  %zu/%zu received\n", values.size(), result.sent);
+        std::printf("  latency us: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                    values.front(), percentile(50), percentile(90), percentile(99), percentile(99.9), values.back());
+        std::printf("  mean %.1f us, jitter %.1f us\n", mean, jitter);
+    }
+}
+
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--count") {
+            options.count = std::clamp<size_t>(std::strtoull(argv[i + 1], nullptr, 10), 1, MaxCount);
+        } else if (std::string_view(argv[i]) == "--interval-us") {
+            options.interval = std::chrono::microseconds(std::atoi(argv[i + 1]));
+        } else if (std::string_view(argv[i]) == "--loopback") {
+            options.loopback = argv[i + 1];
+        }
+    }
+
+    int measured = 0;
+    for (auto backend : MidiBackends::available()) {
+        std::printf("%.*s\n", static_cast<int>(MidiBackends::name(backend).size()), MidiBackends::name(backend).data());
+
+        Result result;
+        if (run(backend, options, result)) {
+            report(result);
+            measured++;
+        } else if (result.sent) {
+            std::printf("  nothing came back\n");
+        }
+    }
+
+    if (measured == 0) {
+        std::fprintf(stderr, "no backend could be measured\n");
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Midi/MidiBackend.h"
+#include "Midi/MidiDevice.h"
+#include "Midi/MidiRealtime.h"
+#include "Utility/RealtimeChecker.h"
+
+// Fails if the steady state input path allocates or takes a blocking lock.
+// No controller is needed: a pair of virtual ports stands in for one, answers
+// the device's identity request as a known controller and then plays notes,
+// controllers, pressure and clock into it, as midi-backend-latency does. The
+// first --warmup seconds cover verification and first-use setup, only the
+// --seconds after count. Thru sends and recording are documented as outside
+// the guarantee and run in an AllocationScopeExemption, so they are not counted.
+//
+// Backends without virtual ports (ALSA raw) are skipped.
+//
+//   midi-realtime-check [--warmup 5] [--seconds 20]
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::string_view VirtualName = "midirework-realtime";
+
+    // Identity reply of the first entry in MidiDeviceDB::KNOWN_DEVICES
+    constexpr unsigned char IdentityReply[] = {
+        0xF0, 0x7E, 0x00, 0x06, 0x02, 0x00, 0x20, 0x29, 0x51, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF7
+    };
+
+    struct Options {
+        int warmup = 5;
+        int seconds = 20;
+    };
+
+    bool matches(const libremidi::port_information& port, std::string_view name) {
+        return port.port_name.find(name) != std::string::npos || port.display_name.find(name) != std::string::npos;
+    }
+
+    template<typename Port>
+    const Port* findPort(const std::vector<Port>& ports, std::string_view name) {
+        auto it = std::find_if(ports.begin(), ports.end(), [name](const Port& port) { return matches(port, name); });
+        return it != ports.end() ? &*it : nullptr;
+    }
+
+    bool isIdentityRequest(const libremidi::message& msg) {
+        return msg.size() >= 6 && msg.bytes[0] == 0xF0 && msg.bytes[1] == 0x7E && msg.bytes[3] == 0x06 && msg.bytes[4] == 0x01;
+    }
+
+    // One step of the played stream, every message type the input path handles
+    void play(libremidi::midi_out& out, size_t step) {
+        const auto channel = static_cast<unsigned char>(step % 16);
+        const auto note = static_cast<unsigned char>(36 + step % 48);
+        const auto value = static_cast<unsigned char>(step % 128);
+
+        const unsigned char noteOn[] = { static_cast<unsigned char>(0x90 | channel), note, 100 };
+        const unsigned char noteOff[] = { static_cast<unsigned char>(0x80 | channel), note, 0 };
+        const unsigned char controller[] = { static_cast<unsigned char>(0xB0 | channel), 1, value };
+        const unsigned char pressure[] = { static_cast<unsigned char>(0xD0 | channel), value };
+        const unsigned char bend[] = { static_cast<unsigned char>(0xE0 | channel), 0, value };
+        const unsigned char clock[] = { 0xF8 };
+
+        out.send_message(noteOn, sizeof(noteOn));
+        out.send_message(controller, sizeof(controller));
+        out.send_message(pressure, sizeof(pressure));
+        out.send_message(bend, sizeof(bend));
+        out.send_message(clock, sizeof(clock));
+        out.send_message(noteOff, sizeof(noteOff));
+    }
+
+    void playFor(libremidi::midi_out& out, std::chrono::seconds duration, size_t& step) {
+        const auto end = Clock::now() + duration;
+        auto next = Clock::now();
+        while (next < end) {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::milliseconds(1);
+            play(out, step++);
+        }
+    }
+
+    // Returns false when the backend couldn't be checked
+    bool check(MidiBackend backend, const Options& options, RealtimeChecker::Violations& violations, uint64_t& messages) {
+        std::atomic<bool> identityRequested{false};
+
+        libremidi::input_configuration config;
+        config.ignore_sysex = false;
+        config.on_message = [&identityRequested](libremidi::message&& msg) {
+            if (isIdentityRequest(msg)) {
+                identityRequested.store(true, std::memory_order_release);
+            }
+        };
+
+        // The controller's ends, the device opens the opposite ones
+        auto in = MidiBackends::makeInput(config, backend);
+        auto out = MidiBackends::makeOutput(libremidi::output_configuration{}, backend);
+        auto observer = MidiBackends::makeObserver(libremidi::observer_configuration{}, backend);
+
+        if (in.open_virtual_port(VirtualName) || out.open_virtual_port(VirtualName)) {
+            std::printf("  no virtual ports, skipped\n");
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        const auto* inPort = findPort(observer.get_input_ports(), VirtualName);
+        const auto* outPort = findPort(observer.get_output_ports(), VirtualName);
+        if (!inPort || !outPort) {
+            std::printf("  virtual ports not reachable, skipped\n");
+            return false;
+        }
+
+        auto device = std::make_unique<MidiDevice>(*inPort, *outPort, MidiCaptureRing::DefaultCapacity,
+                                                   std::pmr::get_default_resource(), backend);
+
+        const auto deadline = Clock::now() + std::chrono::seconds(2);
+        while (!identityRequested.load(std::memory_order_acquire) && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        out.send_message(IdentityReply, sizeof(IdentityReply));
+        while (device->status() != Availability::Available && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (device->status() != Availability::Available) {
+            std::printf("  device did not verify, skipped\n");
+            device->close();
+            return false;
+        }
+
+        // What the manager turns on for its devices
+        std::atomic<uint64_t> dispatched{0};
+        device->onMessage([&dispatched](MidiMessage&) {
+            dispatched.fetch_add(1, std::memory_order_relaxed);
+        });
+        device->enableStatistics(true);
+        device->enableNoteState(true);
+        device->setRealtime(MidiRealtime::DefaultPriority);
+
+        size_t step = 0;
+        playFor(out, std::chrono::seconds(options.warmup), step);
+        RealtimeChecker::reset();
+        dispatched.store(0, std::memory_order_relaxed);
+
+        playFor(out, std::chrono::seconds(options.seconds), step);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        violations = RealtimeChecker::total();
+        messages = dispatched.load(std::memory_order_relaxed);
+
+        device->setRealtime(0);
+        device->close();
+        in.close_port();
+        out.close_port();
+        return true;
+    }
+}
+
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string_view(argv[i]) == "--warmup") {
+            options.warmup = std::atoi(argv[i + 1]);
+        } else if (std::string_view(argv[i]) == "--seconds") {
+            options.seconds = std::atoi(argv[i + 1]);
+        }
+    }
+
+    if (!RealtimeChecker::Enabled) {
+        std::fprintf(stderr, "built without MIDIREWORK_REALTIME_CHECKS, nothing would be counted\n");
+        return 2;
+    }
+
+    MidiRealtime::lockMemory();
+
+    int checked = 0;
+    bool clean = true;
+    for (auto backend : MidiBackends::available()) {
+        std::printf("%.*s\n", static_cast<int>(MidiBackends::name(backend).size()), MidiBackends::name(backend).data());
+
+        RealtimeChecker::Violations violations;
+        uint64_t messages = 0;
+        if (!check(backend, options, violations, messages)) {
+            continue;
+        }
+
+        std::printf("  %llu messages, %llu allocations, %llu blocking locks\n",
+                    static_cast<unsigned long long>(messages),
+                    static_cast<unsigned long long>(violations.allocations),
+                    static_cast<unsigned long long>(violations.locks));
+        if (messages == 0) {
+            std::printf("  no input arrived, nothing was checked\n");
+            continue;
+        }
+        checked++;
+        clean = clean && violations.clean();
+    }
+
+    if (checked == 0) {
+        std::fprintf(stderr, "no backend could be checked\n");
+        return 2;
+    }
+    return clean ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include <cstdio>
+#include <string>
+
+#include "Midi/MidiTraceSink.h"
+
+// Formats a trace written by MidiTraceSink (see main.cpp --trace)
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    MidiTraceReader reader(argv[1]);
+    if (!reader.isOpen()) {
+        return 1;
+    }
+
+    const auto& devices = reader.devices();
+    const auto& records = reader.records();
+    const int64_t origin = records.empty() ? 0 : records.front().timestamp;
+
+    for (const auto& record : records) {
+        const std::string device = record.device < devices.size() ? devices[record.device] : "?";
+        std::printf("%12.3f ms  %-32s", (record.timestamp - origin) / 1.0e6, device.c_str());
+
+        const size_t shown = record.size < MidiTraceRecord::InlineBytes ? record.size : MidiTraceRecord::InlineBytes;
+        for (size_t i = 0; i < shown; i++) {
+            std::printf(" %02X", record.bytes[i]);
+        }
+        if (record.size > MidiTraceRecord::InlineBytes) {
+            std::printf(" ... (%u bytes)", record.size);
+        }
+        std::printf("\n");
+    }
+
+    std::fprintf(stderr, "%zu events from %zu devices\n", records.size(), devices.size());
+    return 0;
+}